@@ -2,6 +2,7 @@
 #define _LCM1602_H_
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <string.h>
 #include "esp_err.h"
 
@@ -78,6 +79,17 @@
  */
 #define HOME_CLEAR_EXEC 2000
 
+// Largest supported display, dimensions of the shadow framebuffer
+#define LCD_MAX_COLS 20
+#define LCD_MAX_ROWS 4
+
+// Transfer buffer of the driver: a full row plus cursor command, 4 bytes per character
+#define LCD_TX_BUF_LEN ((LCD_MAX_COLS + 1) * 4)
+// Number of transfer buffers, while one is sent asynchronously the next one can be filled
+#define LCD_TX_NUM_BUFS 2
+// Upper bound for a queued transfer to finish, a full buffer takes ~8ms at 100kHz
+#define LCD_TX_TIMEOUT_MS 50
+
 esp_err_t LCD_I2C_begin(uint8_t cols, uint8_t lines);
 esp_err_t LCD_I2C_print(const char* str);
 
@@ -108,4 +120,10 @@ void LCD_I2C_noAutoscroll(void);
 void LCD_I2C_createChar(uint8_t location, const uint8_t charmap[]);
 void LCD_I2C_backlight(uint8_t on);
 
+void LCD_I2C_fbWrite(uint8_t col, uint8_t row, const char *str);
+esp_err_t LCD_I2C_flush(void);
+
+// Records LATENCY_STAGE_LCD_WRITE against tick_us, once the transfers queued so far reached the display
+void LCD_I2C_record_write_latency(int64_t tick_us);
+
 #endif // _LCM1602_H_
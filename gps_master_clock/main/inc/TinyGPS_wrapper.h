@@ -8,8 +8,12 @@ extern "C" {
 #include <stdint.h>
 #include <time.h>
 
+#define TINYGPS_WRAPPER_INVALID_ALTITUDE INT32_MAX
+
 bool TinyGPS_wrapper_encode(char c);
 int TinyGPS_wrapper_crack_datetime(struct tm* local, time_t* utc, uint32_t* age);
+// latitude/longitude in 1e-7 degrees, altitude in cm (TINYGPS_WRAPPER_INVALID_ALTITUDE if not known)
+int TinyGPS_wrapper_get_position(int32_t* lat_e7, int32_t* lon_e7, int32_t* alt_cm, uint32_t* age);
 
 #ifdef __cplusplus
 }
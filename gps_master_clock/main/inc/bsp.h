@@ -14,12 +14,14 @@
 #define MAX_WAIT_TICKS          10 // should usually only take 1 ms or less
 
 #define LCM1602_ADDR            0x27
+#define DS3231_ADDR             0x68 // optional RTC
 
 #define NEO6M_UART              UART_NUM_2
 #define NEO6M_RX_PIN            GPIO_NUM_16
 #define NEO6M_TX_PIN            GPIO_NUM_17
 
 #define POWER_GOOD_IO           GPIO_NUM_23
+#define POWER_GOOD_IO_MUX_REG   PERIPHS_IO_MUX_GPIO23_U // for the deep sleep wake stub
 
 #define USR_BUTTON_IO           GPIO_NUM_34
 #define USR_BUTTON_PRESS_LVL    0
@@ -0,0 +1,61 @@
+#ifndef _CLOCKSYNC_H_
+#define _CLOCKSYNC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h> // for time_t
+
+/* Decision logic of the clock synchronization. Free of ESP-IDF and FreeRTOS dependencies, so it can be
+ * compiled and exercised on a host without the hardware. */
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define MINUTES_PER_12H  (12*60)
+
+// The maximum time in minutes the local clock can lead in minutes, before a wraparound must happen
+#define MAX_LOCAL_CLOCK_LEAD_MINUTES  5
+
+// The amount of time that the local second timebase can drift away from the 'correct' time.
+// A bit of 'wiggle' room is left, since the correction requires starting and stopping the
+// timer interrupt.
+#define MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS 2
+
+// The RTC slow clock runs from the internal RC oscillator (a few % after calibration), only trust it shortly
+#define MAX_ANCHOR_AGE_S 3600
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    CLOCKSYNC_IN_SYNC,          // nothing to do
+    CLOCKSYNC_ADVANCE,          // pulse forward
+    CLOCKSYNC_WRAP_AROUND,      // leads too much, pulse forward almost a full turn
+    CLOCKSYNC_WAIT_LEAD,        // leads slightly, wait for the time to catch up
+    CLOCKSYNC_WAIT_PROVISIONAL, // leads, but the time is only an estimate: wait for GPS instead of wrapping around
+} clocksync_action_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Decides what to do at a full minute. Positions are minutes after the 12 o'clock position, the target
+ * may also be a 24h time. The face counts as ahead if moving it backwards would be the shorter way.
+ * minutes is set to the number of pulses, or to the lead for the WAIT actions. */
+clocksync_action_t CLOCKSYNC_minute_sync(int face_minutes, int target_minutes, bool provisional, int* minutes);
+
+/* Whether the tick at utc completes a full minute since the previously handled tick, also if ticks were missed
+ * or the time was set forward across the full minute. previous_utc is 0 for the first tick. */
+bool CLOCKSYNC_minute_crossed(time_t previous_utc, time_t utc);
+
+/* Checks the local second timebase against GPS, clock_diff_s is local - GPS. Returns true if it has to be set
+ * to the GPS time, the correction is then added to the counters. Not for provisional time, its error is no drift. */
+bool CLOCKSYNC_drift_correction(time_t clock_diff_s, bool provisional, uint32_t* total_pos_s, uint32_t* total_neg_s);
+
+/* Estimates the time after a reset from the time anchor: the last tick and the RTC timer value at that moment.
+ * Returns false if the RTC timer did not run on since then, or too long for the RC oscillator to be trusted. */
+bool CLOCKSYNC_anchor_utc(time_t anchor_utc, uint64_t anchor_rtc_us, uint64_t now_rtc_us, time_t* utc);
+
+#endif // _CLOCKSYNC_H_
@@ -15,6 +15,8 @@
 #include "nvs.h"
 #include "nvs_flash.h"
 
+#include "clocksync.h" // for MINUTES_PER_12H
+
 //---------------------------------------------------------------------------
 // Defines
 //---------------------------------------------------------------------------
@@ -22,24 +24,22 @@
 #define MAX_LOG_WAIT_MS 10              // time to wait for UART to become available
 #define MAX_LOG_LEN 512                 // maximum log message length, includes timestamp + func name
 
-#define MINUTES_PER_12H  (12*60)
-
-// The maximum time in minutes the local clock can lead in minutes, before a wraparound must happen
-#define MAX_LOCAL_CLOCK_LEAD_MINUTES  5
-
-// The amount of time that the local second timebase can drift away from the 'correct' time.
-// A bit of 'wiggle' room is left, since the correction requires starting and stopping the
-// timer interrupt.
-#define MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS 2
-
 #define ARRAY_LEN(x) (sizeof(x)/sizeof(x[0]))
 
+// 1: the second timer is dispatched from the esp_timer ISR and notifies TIMEKEEP directly,
+// 0: it runs in the esp_timer task and sends a queue message
+#define SECOND_TICK_ISR 1
+
 #define SET_NVS_DEFAULTS 0 // for debugging, set to 1 and flash to restore NVS defaults
 #define RAM_MIRROR_VALID_MAGIC 0xDEADBEEF // value to indicate the RAM mirror can be used
 
 #define NVS_NAMESPACE   "STORAGE"
 #define KEY_RAM_MIRROR  "RM"
 
+// direct task notification bits, for tasks which wait on their notification instead of the queue
+#define TASK_NOTIFY_TICK  0x01 // second tick, see NEO6M_get_tick()
+#define TASK_NOTIFY_MSG   0x02 // message(s) in the queue
+
 //---------------------------------------------------------------------------
 // Enums
 //---------------------------------------------------------------------------
@@ -94,6 +94,8 @@ typedef struct
 {
   task_type_t dst; // destination of message
   task_cmd_t cmd;
+  int64_t tick_us; // time the originating second tick fired, 0 if the message is not related to a tick
+  bool provisional; // tick related: the time was not yet verified by GPS (RTC or estimate after reset)
   union // payload, can be unused
   {
     time_t utc_time;
@@ -122,6 +124,11 @@ typedef struct
   uint16_t pulse_len_ms;
   uint16_t pulse_pause_ms;
 
+  // last GPS position, to aid the receiver after a restart
+  int32_t last_lat_e7; // 1e-7 degrees
+  int32_t last_lon_e7; // 1e-7 degrees
+  int32_t last_alt_cm; // INT32_MAX if unknown
+  uint32_t last_pos_valid; // 0 if never had a position fix
 } ram_mirror_t;
 
 //---------------------------------------------------------------------------
@@ -139,6 +146,7 @@ void serial_print_custom(void);
 bool receiveTaskMessage(task_type_t dst, uint32_t timeout, task_msg_t *msg);
 bool sendTaskMessage(task_msg_t *msg);
 bool sendTaskMessageISR(task_msg_t *msg);
+bool notifyTaskISR(task_type_t dst, uint32_t bits);
 
 esp_err_t store_ram_mirror(void);
 
@@ -0,0 +1,27 @@
+#ifndef _DEEPSLEEP_H_
+#define _DEEPSLEEP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// set to 0 to only suspend the tasks on power bad (CPU idles at DFS_MIN_FREQ_MHZ, faster resume but a lot more current)
+#define DEEP_SLEEP_ON_POWER_FAIL 1
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Power fail mode. POWER_GOOD_IO is no RTC IO, so it can not be used as ext0/ext1 wake source. Instead the
+ * RTC timer wakes the chip periodically and a wake stub samples the pin, going right back to sleep
+ * without booting while power is bad. The RTC timer keeps counting in deep sleep, so the time anchor in
+ * neo6m.c provides the elapsed time after the wakeup. Does not return. */
+void DEEPSLEEP_enter(void);
+
+// Call first thing in app_main. True if the reset was the wakeup from the power fail mode.
+bool DEEPSLEEP_woke_up(uint64_t* slept_us, uint32_t* polls);
+
+#endif // _DEEPSLEEP_H_
@@ -0,0 +1,46 @@
+#ifndef _DFS_H_
+#define _DFS_H_
+
+#include "esp_err.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define DFS_MAX_FREQ_MHZ 240
+#define DFS_MIN_FREQ_MHZ 80 // the APB clock stays at 80MHz down to here, UART baud rates are not affected
+
+/* Automatic light sleep when no lock is held. Off: there are no wake sources configured, bytes from the NEO-6M
+ * (UART2 can not wake the chip, a GPIO wakeup on its RX pin loses the first character) and power bad edges would
+ * be lost or delayed by up to a tick. Enabling it needs gpio_wakeup_enable() for POWER_GOOD_IO and USR_BUTTON_IO
+ * plus an ESP_PM_NO_LIGHT_SLEEP lock while NEO6M_Task waits for data. */
+#define DFS_LIGHT_SLEEP 0
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    DFS_LOCK_GPS_PARSE, // CPU max: processing of a received NMEA sentence
+    DFS_LOCK_PULSE,     // APB max: full speed during a pulse (see DFS_print_stats), no light sleep if enabled
+    DFS_LOCK_I2C,       // APB max: full speed during a bus transaction, no light sleep if enabled
+    NUM_DFS_LOCK
+} dfs_lock_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Dynamic frequency scaling between DFS_MIN_FREQ_MHZ and DFS_MAX_FREQ_MHZ, see DFS_LIGHT_SLEEP.
+ * The timing critical sections hold a lock, the time spent with the CPU lock held, with only APB
+ * locks held and without any lock is accounted as lock residency and printed with the CPU frequency
+ * each level results in. CONFIG_PM_PROFILING additionally prints the time per mode as measured by ESP-IDF. */
+esp_err_t DFS_init(void);
+
+// not recursive, acquiring a held lock or releasing a free one does nothing
+void DFS_acquire(dfs_lock_t lock);
+void DFS_release(dfs_lock_t lock);
+
+void DFS_print_stats(void);
+
+#endif // _DFS_H_
@@ -0,0 +1,31 @@
+#ifndef _DRIFT_H_
+#define _DRIFT_H_
+
+#include <stdint.h>
+#include <time.h>
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// Amount of (utc, offset) samples. Once full, every other sample is dropped and the sample
+// interval doubles, up to DRIFT_MAX_INTERVAL_S. From then on the oldest samples get overwritten.
+#define DRIFT_NUM_SAMPLES       256
+#define DRIFT_MAX_INTERVAL_S    64  // 256 * 64s = ~4.5h of history
+
+#define DRIFT_DUMP_INTERVAL_S   3600
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Offset of the local timebase (esp_timer, derived from the crystal) against GPS. Only the NMEA
+ * timing is available (no PPS), so the phase noise floor is in the order of a few ms. Recorded by
+ * NEO6M_Task, dumped by STATS_Task. */
+void DRIFT_record(time_t utc, int64_t local_us);
+
+/* Prints the samples as CSV, followed by the estimated frequency offset and Allan deviation. Takes ~0.4s of
+ * UART time, so call it from a low priority task. tools/drift_analysis.py evaluates the CSV offline. */
+void DRIFT_dump(void);
+
+#endif // _DRIFT_H_
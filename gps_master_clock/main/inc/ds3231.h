@@ -0,0 +1,34 @@
+#ifndef _DS3231_H_
+#define _DS3231_H_
+
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// Re-discipline the RTC from GPS this often while locked. The DS3231 is specified with +-2ppm
+// (~5s per month), so once per hour is plenty.
+#define DS3231_SYNC_INTERVAL_S 3600
+
+// Only sync from fixes younger than this. Writing the seconds register restarts the RTC's
+// countdown chain, so the RTC second starts roughly "age" late.
+#define DS3231_SYNC_MAX_AGE_MS 200
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Optional battery backed RTC on the shared I2C bus. All functions return an error when no
+ * RTC was detected during init, so callers can treat it as a best effort time source. */
+esp_err_t DS3231_init(void);
+bool DS3231_present(void);
+
+// returns ESP_ERR_INVALID_STATE if the oscillator was stopped (e.g. battery empty), the time is invalid then
+esp_err_t DS3231_read_utc(time_t* utc);
+// sets the time and clears the oscillator stop flag
+esp_err_t DS3231_write_utc(time_t utc);
+
+#endif // _DS3231_H_
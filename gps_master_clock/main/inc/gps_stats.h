@@ -0,0 +1,74 @@
+#ifndef _GPS_STATS_H_
+#define _GPS_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nvs.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define KEY_GPS_STATS           "GS"
+#define GPS_STATS_VERSION       1 // increment when the persisted layout changes
+
+#define GPS_STATS_TTFF_HISTORY  8 // TTFF of the last boots
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    GPS_OUTAGE_10S,
+    GPS_OUTAGE_1MIN,
+    GPS_OUTAGE_10MIN,
+    GPS_OUTAGE_1H,
+    GPS_OUTAGE_6H,
+    GPS_OUTAGE_1D,
+    GPS_OUTAGE_LONGER,
+    NUM_GPS_OUTAGE
+} gps_outage_bucket_t;
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+// persisted as is, keep it compact
+typedef struct
+{
+    uint16_t version; // GPS_STATS_VERSION
+    uint16_t len;     // sizeof(gps_stats_t), in case the version was not bumped
+
+    uint16_t ttff_s[GPS_STATS_TTFF_HISTORY]; // ring buffer, saturates at UINT16_MAX
+    uint8_t ttff_head; // next index to write
+    uint8_t ttff_cnt;  // valid entries
+
+    uint32_t lock_losses;
+    uint32_t locked_s;
+    uint32_t outages[NUM_GPS_OUTAGE]; // histogram of the holdover durations
+} gps_stats_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* GPS acquisition statistics: time to first fix per boot, lock losses, how long the holdover periods
+ * (lock lost until regained) lasted and the total time spent locked. Persisted next to the RAM mirror. */
+esp_err_t GPS_STATS_load(nvs_handle_t nvs_handle, bool soft_reset);
+esp_err_t GPS_STATS_save(nvs_handle_t nvs_handle);
+void GPS_STATS_reset(void);
+
+// consistent copy including the current lock period, e.g. for the power fail snapshot, and its restore
+void GPS_STATS_get(gps_stats_t* copy);
+esp_err_t GPS_STATS_set(const gps_stats_t* restored);
+
+void GPS_STATS_first_fix(uint32_t ttff_ms);
+void GPS_STATS_lock_changed(bool locked);
+
+uint32_t GPS_STATS_get_last_ttff_s(void);
+uint32_t GPS_STATS_get_lock_losses(void);
+uint32_t GPS_STATS_get_locked_s(void);
+
+void GPS_STATS_print(void);
+
+#endif // _GPS_STATS_H_
@@ -0,0 +1,62 @@
+#ifndef _I2C_BUS_H_
+#define _I2C_BUS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define I2C_BUS_MAX_DEVICES 4
+
+// upper bound to get a device's previous transaction done, includes waiting for higher priorities
+#define I2C_BUS_MAX_TRANSACTION_MS 100
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    I2C_BUS_PRIO_LOW,   // bulk transfers, e.g. display redraws
+    I2C_BUS_PRIO_HIGH,  // time critical, e.g. RTC access
+    NUM_I2C_BUS_PRIO
+} i2c_bus_prio_t;
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct i2c_bus_dev* i2c_bus_dev_handle_t;
+
+// called by the bus manager when a transaction of the device is done, before I2C_BUS_wait returns
+typedef void (*i2c_bus_done_cb_t)(void* arg, esp_err_t result, int64_t done_us);
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* The bus manager owns the I2C bus, all transactions are executed by I2C_BUS_Task. Pending
+ * transactions are served by device priority, each device can have one transaction in flight. */
+esp_err_t I2C_BUS_init(void);
+esp_err_t I2C_BUS_add_device(uint8_t addr, i2c_bus_prio_t prio, const char* name, i2c_bus_dev_handle_t* dev);
+esp_err_t I2C_BUS_probe(uint8_t addr);
+// optional, the callback runs in I2C_BUS_Task and must be short
+void I2C_BUS_set_done_cb(i2c_bus_dev_handle_t dev, i2c_bus_done_cb_t cb, void* arg);
+
+// queue a transaction and return, the buffers must stay valid until it is done (see I2C_BUS_wait)
+esp_err_t I2C_BUS_submit(i2c_bus_dev_handle_t dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len);
+// wait until the last transaction of the device is done, returns its result
+esp_err_t I2C_BUS_wait(i2c_bus_dev_handle_t dev, uint32_t timeout_ms);
+// submit + wait
+esp_err_t I2C_BUS_transfer(i2c_bus_dev_handle_t dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len, uint32_t timeout_ms);
+
+void I2C_BUS_print_stats(void);
+
+// executes the highest priority pending transaction, waits up to timeout_ms (UINT32_MAX: forever) for one.
+// Returns false if there was none. I2C_BUS_Task does nothing else, host tests call it directly.
+bool I2C_BUS_process(uint32_t timeout_ms);
+void I2C_BUS_Task(void *parameter);
+
+#endif // _I2C_BUS_H_
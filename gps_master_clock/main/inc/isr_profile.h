@@ -0,0 +1,46 @@
+#ifndef _ISR_PROFILE_H_
+#define _ISR_PROFILE_H_
+
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// set to 1 to record the entry-to-exit time of the interrupt handlers. With 0 the profile points compile to nothing
+#define ISR_PROFILE_ENABLE 0
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    ISR_PROFILE_PWR_GOOD,
+    ISR_PROFILE_BTN,
+    NUM_ISR_PROFILE
+} isr_profile_id_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+#if ISR_PROFILE_ENABLE
+
+#include "esp_cpu.h" // for cycle counter
+
+void ISR_PROFILE_record(isr_profile_id_t id, uint32_t cycles);
+void ISR_PROFILE_print_stats(void);
+
+#define ISR_PROFILE_BEGIN()     uint32_t isr_profile_start = esp_cpu_get_cycle_count()
+#define ISR_PROFILE_END(id)     ISR_PROFILE_record(id, esp_cpu_get_cycle_count() - isr_profile_start)
+#define ISR_PROFILE_PRINT()     ISR_PROFILE_print_stats()
+
+#else
+
+#define ISR_PROFILE_BEGIN()     do { } while (0)
+#define ISR_PROFILE_END(id)     do { } while (0)
+#define ISR_PROFILE_PRINT()     do { } while (0)
+
+#endif // ISR_PROFILE_ENABLE
+
+#endif // _ISR_PROFILE_H_
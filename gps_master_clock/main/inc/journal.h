@@ -0,0 +1,22 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define JOURNAL_PARTITION_LABEL "journal" // see partitions.csv
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Append only flash journal of the hand position, so every pulse is durable without rewriting
+ * the whole RAM mirror blob. Returns ESP_ERR_NOT_FOUND if the journal holds no position yet. */
+esp_err_t JOURNAL_init(int* minutes_12o_clock);
+esp_err_t JOURNAL_record_position(int minutes_12o_clock);
+
+#endif // _JOURNAL_H_
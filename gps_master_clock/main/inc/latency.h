@@ -0,0 +1,39 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// histogram bucket n counts latencies of [2^(n-1), 2^n) us, the last one everything from 2^19 us (~524ms) on
+#define LATENCY_NUM_BUCKETS 21
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+
+// pipeline stages of a second tick, each measured relative to the time the second timer fired
+typedef enum
+{
+    LATENCY_STAGE_TIMEKEEP_RX,  // tick received by TIMEKEEP_Task
+    LATENCY_STAGE_LOCALTIME,    // local time determined
+    LATENCY_STAGE_PULSE_EDGE,   // first pulse edge of a minute sync
+    LATENCY_STAGE_LCD_RX,       // local time received by LCD_Task
+    LATENCY_STAGE_LCD_WRITE,    // new second written to the LCD
+    LATENCY_STAGE_GPS_PARSE,    // not tick related: NMEA sentence complete until it is processed
+    LATENCY_STAGE_TICK_PERIOD,  // deviation of the interval between two ticks from one second
+    NUM_LATENCY_STAGES
+} latency_stage_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+// both can be used from ISRs
+void LATENCY_record(latency_stage_t stage, int64_t tick_us);
+void LATENCY_record_us(latency_stage_t stage, uint32_t latency_us);
+void LATENCY_print_stats(void);
+
+#endif // _LATENCY_H_
@@ -0,0 +1,35 @@
+#ifndef _MIRROR_H_
+#define _MIRROR_H_
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+/* Layout history of ram_mirror_t, increment RAM_MIRROR_VERSION and add a migration in mirror.c
+ * whenever the struct changes:
+ * 1: raw struct without header, up to the pulse settings
+ * 2: header (version, length, CRC32) + struct, + last position */
+#define RAM_MIRROR_VERSION 2
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Persistence of the RAM mirror (rm). In NVS it is stored with a header, older layouts are migrated
+ * field by field when loading. The copy in RTC RAM has its own header which is updated by
+ * MIRROR_checkpoint(), so after a soft reset it is only trusted if it was not corrupted.
+ * A reset between a modification of rm and the following checkpoint leaves a CRC which does not match
+ * (torn update). MIRROR_rtc_valid() then fails and the boot loads the last NVS store or snapshot instead,
+ * the modifications since then are lost. */
+esp_err_t MIRROR_load(nvs_handle_t nvs_handle);
+esp_err_t MIRROR_save(nvs_handle_t nvs_handle);
+
+// call after modifying rm, takes a few us
+void MIRROR_checkpoint(void);
+bool MIRROR_rtc_valid(void);
+
+#endif // _MIRROR_H_
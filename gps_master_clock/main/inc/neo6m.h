@@ -1,6 +1,24 @@
 #ifndef _NEO6M_H_
 #define _NEO6M_H_
 
+#include <stdint.h>
+
+#include "custom_main.h" // for task_msg_t
+
+// set to 1 to echo the raw receiver output to the log UART, to record a corpus of real NMEA streams. The
+// timestamps accepted by the parser are logged in between, as the expected result of a replay
+#define NMEA_CAPTURE 0
+#define NMEA_CAPTURE_LINE_LEN 96 // NMEA sentences are at most 82 characters
+
 void NEO6M_Task(void *parameter);
 
-#endif // _NEO6M_H_
\ No newline at end of file
+// copy of the latest second tick message, returns its sequence number
+uint32_t NEO6M_get_tick(task_msg_t* msg);
+
+// keep the time anchor for software resets up to date, with a tick received by TIMEKEEP
+void NEO6M_update_anchor(const task_msg_t* tick);
+
+// parser throughput since the last call
+void NEO6M_print_stats(void);
+
+#endif // _NEO6M_H_
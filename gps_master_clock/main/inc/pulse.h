@@ -0,0 +1,88 @@
+#ifndef _PULSE_H_
+#define _PULSE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h> // for time_t
+
+#include "clocksync.h"
+
+/* State machine of TIMEKEEP: the second ticks, the minute sync and the pulses which advance the slave clock.
+ * Free of ESP-IDF and FreeRTOS dependencies like clocksync, the time is passed in by the caller. TIMEKEEP_Task
+ * does the I/O for the events, the host simulation drives it in virtual time. */
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// events of PULSE_step(), to be handled in this order
+#define PULSE_EV_HIGH       0x01 // end of the low phase, set the output high
+#define PULSE_EV_DONE       0x02 // end of the pause, set the output low. The face moved on by a minute
+#define PULSE_EV_SUSPEND    0x04 // shutdown requested and no pulse in progress
+#define PULSE_EV_START      0x08 // start of the next pulse, set the output low
+#define PULSE_EV_FACE       0x10 // the face reached the target time of a minute sync, see face_provisional
+
+#define PULSE_NO_WAKEUP     INT64_MAX // of PULSE_wakeup_us(): nothing to do until the next message
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+
+// Phases of a clock pulse, the waveform is: low for len_ms, high for pause_ms, then low again
+typedef enum
+{
+    PULSE_IDLE,
+    PULSE_ACTIVE,
+    PULSE_PAUSE,
+} pulse_phase_t;
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+typedef struct
+{
+    uint16_t len_ms;
+    uint16_t pause_ms;
+    pulse_phase_t phase;
+    int64_t next_us; // time of the next transition of the current pulse
+    int minutes_diff; // pulses not yet started, negative while the face leads
+    time_t last_tick_utc; // of the previously handled tick, to notice full minutes which had no tick of their own
+    uint32_t last_seq; // of the previously received tick, 0 before the first
+    bool commissioning;
+    bool shutdown_pending; // suspend once the current pulse is complete
+    bool face_check; // waiting for the face to reach the target time of a minute sync
+    bool face_provisional; // ... and whether that target time was provisional
+    bool face_logged[2]; // per provisional/verified, only report the first time after boot
+} pulse_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+void PULSE_init(pulse_t* pulse, uint16_t len_ms, uint16_t pause_ms);
+
+/* Ticks which were not received since the previous one, from their sequence numbers (see NEO6M_get_tick()).
+ * The notification only holds one tick, the time is still right but the seconds have to be accounted. */
+uint32_t PULSE_missed_ticks(pulse_t* pulse, uint32_t seq);
+
+// A received second tick, returns whether it completes a full minute. No minute sync while commissioning.
+bool PULSE_tick(pulse_t* pulse, time_t utc);
+
+/* Minute sync of the face (rm.current_minutes_12o_clock) to the local time of the tick, a pulse in progress
+ * counts as done. Sets the pulses to do, see CLOCKSYNC_minute_sync() for the result. */
+clocksync_action_t PULSE_minute_sync(pulse_t* pulse, int face_minutes, int target_minutes, bool provisional,
+    int* minutes);
+
+// Commissioning: no minute sync, the face is moved by hand with PULSE_advance()
+void PULSE_commissioning(pulse_t* pulse, bool on);
+void PULSE_advance(pulse_t* pulse, int minutes);
+void PULSE_shutdown(pulse_t* pulse);
+
+// When PULSE_step() is due: now_us or earlier if right away, the next transition or PULSE_NO_WAKEUP
+int64_t PULSE_wakeup_us(const pulse_t* pulse);
+
+// Transitions due at now_us, returns the PULSE_EV_* which happened. face_minutes is advanced on PULSE_EV_DONE.
+uint32_t PULSE_step(pulse_t* pulse, int64_t now_us, int* face_minutes);
+
+#endif // _PULSE_H_
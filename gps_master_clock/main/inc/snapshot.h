@@ -0,0 +1,38 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#include "custom_main.h" // for ram_mirror_t
+#include "gps_stats.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define SNAPSHOT_PARTITION_LABEL "snapshot" // see partitions.csv
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+// everything which is otherwise only persisted by the NVS store
+typedef struct
+{
+    ram_mirror_t rm;
+    gps_stats_t gps_stats;
+} snapshot_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Emergency save of the RAM mirror and the GPS stats on power loss. The snapshot sector is kept erased, so a save is a
+ * single flash program operation (no erase, no NVS bookkeeping). At the next boot the newest snapshot
+ * is handed to the normal NVS handling and the sector gets erased again. */
+esp_err_t SNAPSHOT_init(snapshot_t* newest, bool* found);
+esp_err_t SNAPSHOT_save(void);
+esp_err_t SNAPSHOT_clear(void);
+
+#endif // _SNAPSHOT_H_
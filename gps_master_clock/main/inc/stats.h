@@ -0,0 +1,18 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define STATS_INTERVAL_S 60 // print stats every minute
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+/* Prints the statistics of all modules every STATS_INTERVAL_S. The reports and dumps take a few kB up to
+ * a few 10 kB of log output, so they run in this task at idle priority instead of in a timing critical one. */
+void STATS_Task(void *parameter);
+
+#endif // _STATS_H_
@@ -9,4 +9,7 @@ void TIMEKEEP_Task(void *parameter);
 void take_tz_mutex(void);
 void give_tz_mutex(void);
 
+// wakeups of the task since the last call
+void TIMEKEEP_print_stats(void);
+
 #endif // _TIMEKEEP_H_
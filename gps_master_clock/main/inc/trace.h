@@ -0,0 +1,55 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// for profiling, set to 1 to record begin/end events of the hot paths. With 0 all trace points compile to nothing
+#define TRACE_ENABLE 0
+
+// amount of events kept in the ring buffer, the oldest events get overwritten (8 bytes each). ~25 events/s
+// with a GPS fix, this covers the minute between two dumps
+#define TRACE_BUF_LEN 2048
+
+// tasks told apart in the trace ("tid"), further tasks are recorded as the last one
+#define TRACE_MAX_TASKS 15
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    TRACE_ID_GPS_SENTENCE, // reception of one NMEA line, '$' up to the line end
+    TRACE_ID_GPS_CRACK_DATETIME,
+    TRACE_ID_LOCALTIME,
+    TRACE_ID_LCD_DEFAULT_DISPLAYS,
+    TRACE_ID_PULSE,
+    NUM_TRACE_ID
+} trace_id_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+#if TRACE_ENABLE
+
+void TRACE_record(trace_id_t id, bool begin);
+void TRACE_dump(void);
+
+#define TRACE_BEGIN(id) TRACE_record(id, true)
+#define TRACE_END(id)   TRACE_record(id, false)
+#define TRACE_DUMP()    TRACE_dump()
+
+#else
+
+#define TRACE_BEGIN(id) do { } while (0)
+#define TRACE_END(id)   do { } while (0)
+#define TRACE_DUMP()    do { } while (0)
+
+#endif // TRACE_ENABLE
+
+#endif // _TRACE_H_
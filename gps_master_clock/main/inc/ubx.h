@@ -0,0 +1,59 @@
+#ifndef _UBX_H_
+#define _UBX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// UBX protocol, see u-blox 6 receiver description
+#define UBX_SYNC_1          0xB5
+#define UBX_SYNC_2          0x62
+#define UBX_CLASS_AID       0x0B
+#define UBX_ID_AID_INI      0x01
+#define UBX_AID_INI_LEN     48
+#define UBX_FRAME_OVERHEAD  8 // sync, class, id, length, checksum
+
+#define UBX_AID_INI_FLAG_POS    0x01
+#define UBX_AID_INI_FLAG_TIME   0x02
+#define UBX_AID_INI_FLAG_LLA    0x20
+#define UBX_AID_INI_FLAG_ALTINV 0x40
+
+#define UBX_AID_INI_POS_ACC_CM  100000 // the clock is stationary, but might have been moved since the last fix
+#define UBX_AID_INI_TIME_ACC_MS 2000   // provisional time is accurate to about a second
+
+#define GPS_EPOCH_UTC       315964800 // 1980-01-06
+#define GPS_LEAP_SECONDS    18        // GPS - UTC, unchanged since 2017
+#define SECONDS_PER_WEEK    (7 * 24 * 3600)
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+// what we know to aid the receiver with
+typedef struct
+{
+    bool pos_valid;
+    int32_t lat_e7;     // 1e-7 degrees
+    int32_t lon_e7;
+    bool alt_valid;
+    int32_t alt_cm;
+    bool time_valid;
+    time_t utc;
+} ubx_aid_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+// Fills the UBX-AID-INI payload, returns its flags. 0: nothing to aid with, the message should not be sent
+uint32_t UBX_aid_ini_payload(uint8_t payload[UBX_AID_INI_LEN], const ubx_aid_t* aid);
+
+// Builds a complete frame with sync chars and checksum, returns its length or 0 if it does not fit into frame_len
+size_t UBX_frame(uint8_t* frame, size_t frame_len, uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t len);
+
+#endif // _UBX_H_
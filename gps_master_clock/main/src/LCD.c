@@ -1,8 +1,16 @@
 #include "LCD.h"
 #include "LCM1602.h"
 
+#include "hal/gpio_ll.h" // IRAM safe pin access for btn_handler
+#include "soc/gpio_struct.h"
+
 #include "custom_main.h"
 #include "bsp.h"
+#include "trace.h"
+#include "latency.h"
+#include "gps_stats.h"
+#include "journal.h"
+#include "mirror.h"
 
 
 //---------------------------------------------------------------------------
@@ -14,6 +22,8 @@
 
 #define GRAM_BACKSLASH_INDEX 1
 
+// Redraws happen with every new second, this timer only adds the intermediate scroll refresh.
+// It is restarted with each second, so it stays phase aligned to the tick.
 #define REFRESH_INTERVAL_MS     ( 500 / portTICK_PERIOD_MS ) 
 
 // '13:08:00 15.11.2025 DST: 0    ' = 26 chars + 4 spaces + 1 null
@@ -35,6 +45,8 @@ enum
     STATUS_GPS_LOCK = STATUS_START_IDX,
     STATUS_CORRECTION_POS,
     STATUS_CORRECTION_NEG,
+    STATUS_GPS_TTFF,
+    STATUS_GPS_LOCK_LOSSES,
     STATUS_TOTAL_UPTIME,
     STATUS_CLOCK_FACE_TIME,
     NUM_STATUS_IDX
@@ -108,18 +120,14 @@ static void LCD_print_commissioning_displays(uint8_t* operating_state)
     {
         case COMM_MENU_SEL_MASTER:
         {
-            LCD_I2C_setCursor(0, 0);
-            LCD_I2C_print("Commissioning   ");
-            LCD_I2C_setCursor(0, 1);
-            LCD_I2C_print(">Master advance ");
+            LCD_I2C_fbWrite(0, 0, "Commissioning   ");
+            LCD_I2C_fbWrite(0, 1, ">Master advance ");
             break;
         }
         case COMM_MENU_SEL_SLAVE:
         {
-            LCD_I2C_setCursor(0, 0);
-            LCD_I2C_print("Commissioning   ");
-            LCD_I2C_setCursor(0, 1);
-            LCD_I2C_print(">Slave advance  ");
+            LCD_I2C_fbWrite(0, 0, "Commissioning   ");
+            LCD_I2C_fbWrite(0, 1, ">Slave advance  ");
             break;
         }
         case COMM_MASTER_ADVANCE_WAIT_MIN:
@@ -133,11 +141,11 @@ static void LCD_print_commissioning_displays(uint8_t* operating_state)
             uint8_t hours = rm.current_minutes_12o_clock / 60;
             uint8_t minutes = rm.current_minutes_12o_clock % 60;
 
-            LCD_I2C_setCursor(0, 0);
-            LCD_I2C_print("Master advance  ");
-            LCD_I2C_setCursor(0, 1);
+            LCD_I2C_fbWrite(0, 0, "Master advance  ");
             snprintf(scratch_buff, sizeof(scratch_buff), "%02u:%02u           ", hours, minutes);
-            LCD_I2C_print(scratch_buff);
+            LCD_I2C_fbWrite(0, 1, scratch_buff);
+
+            LCD_I2C_flush(); // cursor must be placed after the content was written
 
             uint8_t cursor_pos = (*operating_state == COMM_MASTER_ADVANCE_MIN) ? 4 : 1;
             LCD_I2C_setCursor(cursor_pos, 1);
@@ -147,9 +155,11 @@ static void LCD_print_commissioning_displays(uint8_t* operating_state)
             break;
         }
     }
+
+    LCD_I2C_flush();
 }
 
-static void LCD_print_default_displays(char* time_print_buff, int status_screen_idx, GPS_LOCK_STATE_t lock_state_local)
+static void LCD_print_default_displays(char* time_print_buff, int status_screen_idx, GPS_LOCK_STATE_t lock_state_local, bool provisional)
 {
     static int curr_src_start = 0; // index where to start copying from the time buffer
     static int wait_animation_idx = 0;
@@ -175,22 +185,21 @@ static void LCD_print_default_displays(char* time_print_buff, int status_screen_
 
     // print the result
     scratch_buff[NUM_COLUMNS] = 0;
-    LCD_I2C_setCursor(0, 0);
-    LCD_I2C_print(scratch_buff);
+    LCD_I2C_fbWrite(0, 0, scratch_buff);
 
-    LCD_I2C_setCursor(0, 1);
     switch(status_screen_idx)
     {
         case STATUS_GPS_LOCK:
         {
             if (lock_state_local == GPS_LOCKED)
             {
-                LCD_I2C_print("GPS locked      ");
+                LCD_I2C_fbWrite(0, 1, "GPS locked      ");
             }
             else
-            {
-                snprintf(scratch_buff, sizeof(scratch_buff), "Await GPS lock %c", wait_animation[wait_animation_idx]);
-                LCD_I2C_print(scratch_buff);
+            { // the time is only estimated until the first lock
+                snprintf(scratch_buff, sizeof(scratch_buff), provisional ? "Time estimated %c" : "Await GPS lock %c",
+                    wait_animation[wait_animation_idx]);
+                LCD_I2C_fbWrite(0, 1, scratch_buff);
 
                 wait_animation_idx++;
                 if (wait_animation_idx >= ARRAY_LEN(wait_animation))
@@ -201,13 +210,25 @@ static void LCD_print_default_displays(char* time_print_buff, int status_screen_
         case STATUS_CORRECTION_POS:
         {
             snprintf(scratch_buff, sizeof(scratch_buff), "Lag:   %8lus", rm.total_pos_time_corrected);
-            LCD_I2C_print(scratch_buff);
+            LCD_I2C_fbWrite(0, 1, scratch_buff);
             break;
         }
         case STATUS_CORRECTION_NEG:
         {
             snprintf(scratch_buff, sizeof(scratch_buff), "Lead:  %8lus", rm.total_neg_time_corrected);
-            LCD_I2C_print(scratch_buff);
+            LCD_I2C_fbWrite(0, 1, scratch_buff);
+            break;
+        }
+        case STATUS_GPS_TTFF:
+        {
+            snprintf(scratch_buff, sizeof(scratch_buff), "TTFF:  %8lus", GPS_STATS_get_last_ttff_s());
+            LCD_I2C_fbWrite(0, 1, scratch_buff);
+            break;
+        }
+        case STATUS_GPS_LOCK_LOSSES:
+        {
+            snprintf(scratch_buff, sizeof(scratch_buff), "Lock lost: %5lu", GPS_STATS_get_lock_losses());
+            LCD_I2C_fbWrite(0, 1, scratch_buff);
             break;
         }
         case STATUS_TOTAL_UPTIME:
@@ -228,7 +249,7 @@ static void LCD_print_default_displays(char* time_print_buff, int status_screen_
                 }
             }
             snprintf(scratch_buff, sizeof(scratch_buff), "Uptime %8lu%c", uptime_val, uptime_unit);
-            LCD_I2C_print(scratch_buff);
+            LCD_I2C_fbWrite(0, 1, scratch_buff);
             break;
         }
         case STATUS_CLOCK_FACE_TIME:
@@ -236,7 +257,7 @@ static void LCD_print_default_displays(char* time_print_buff, int status_screen_
             uint8_t hours = rm.current_minutes_12o_clock / 60;
             uint8_t minutes = rm.current_minutes_12o_clock % 60;
             snprintf(scratch_buff, sizeof(scratch_buff), "Clock:     %02u:%02u", hours, minutes);
-            LCD_I2C_print(scratch_buff);
+            LCD_I2C_fbWrite(0, 1, scratch_buff);
             break;
         }
         default:
@@ -244,18 +265,21 @@ static void LCD_print_default_displays(char* time_print_buff, int status_screen_
             break;
         }
     }
+
+    LCD_I2C_flush(); // only the changed characters are sent
 }
 
 //---------------------------------------------------------------------------
 // Global functions
 //---------------------------------------------------------------------------
-void btn_handler(bool timer_triggered)
+// Called from the GPIO ISR and the button timer, so it is in IRAM and only uses the inlined gpio_ll functions
+void IRAM_ATTR btn_handler(bool timer_triggered)
 {
     static task_msg_t msg = {.dst = TASK_LCD, .cmd = TASK_CMD_BTN_PRESS, .btn_state = BTN_NO_PRESS};
 
 
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    int btn_lvl = gpio_get_level(USR_BUTTON_IO);
+    int btn_lvl = gpio_ll_get_level(&GPIO, USR_BUTTON_IO);
     uint32_t tim_period = 0;
     bool restart = false;
 
@@ -271,7 +295,7 @@ void btn_handler(bool timer_triggered)
             {
                 msg.btn_state = BTN_DEBOUNCE; // reset state back to start
                 tim_period = DEBOUNCE_DURATION_MS; // wait for voltage to stabilize
-                gpio_set_intr_type(USR_BUTTON_IO, GPIO_INTR_DISABLE); // ignore any ISR
+                gpio_ll_set_intr_type(&GPIO, USR_BUTTON_IO, GPIO_INTR_DISABLE); // ignore any ISR
             }
             break;
         }
@@ -281,7 +305,7 @@ void btn_handler(bool timer_triggered)
             {
                 msg.btn_state = BTN_SHORT_PRESS;
                 tim_period = LONG_PRESS_DURATION_MS;
-                gpio_set_intr_type(USR_BUTTON_IO, GPIO_INTR_POSEDGE); // await rising edge
+                gpio_ll_set_intr_type(&GPIO, USR_BUTTON_IO, GPIO_INTR_POSEDGE); // await rising edge
             }
             else // not yet settled
             {
@@ -352,7 +376,7 @@ void btn_handler(bool timer_triggered)
             xTimerStopFromISR(btn_timer, &xHigherPriorityTaskWoken); // make sure the timer is off
         }
         msg.btn_state = BTN_NO_PRESS; // reset state
-        gpio_set_intr_type(USR_BUTTON_IO, GPIO_INTR_NEGEDGE);
+        gpio_ll_set_intr_type(&GPIO, USR_BUTTON_IO, GPIO_INTR_NEGEDGE);
     }
     else if (tim_period)
     {
@@ -381,8 +405,10 @@ void LCD_Task(void *parameter)
 
     task_msg_t msg;
     GPS_LOCK_STATE_t lock_state_local = GPS_LOCK_UNINITIALIZED;
+    bool provisional = false; // shown time is not yet verified by GPS
     struct tm tm; // local time struct
     uint8_t operating_state = MODE_NORMAL;
+    int64_t time_tick_us = 0; // tick of the formatted time which was not yet written to the display
 
     if (LCD_I2C_begin(NUM_COLUMNS, NUM_ROWS) != ESP_OK)
     { // in case no display was found
@@ -428,6 +454,8 @@ void LCD_Task(void *parameter)
 
     while(1)
     {
+        bool refresh = false;
+
         if (receiveTaskMessage(TASK_LCD, 500, &msg) == true)
         {
             switch(msg.cmd)
@@ -439,6 +467,10 @@ void LCD_Task(void *parameter)
                 }
                 case TASK_CMD_LOCAL_TIME:
                 {
+                    LATENCY_record(LATENCY_STAGE_LCD_RX, msg.tick_us);
+                    time_tick_us = msg.tick_us;
+                    provisional = msg.provisional;
+
                     // format the new time into local buffer
                     tm = msg.local_time;
                     snprintf(time_print_buff, sizeof(time_print_buff), "%02u:%02u:%02u %02u.%02u.%04u DST: %1u    ",
@@ -456,6 +488,11 @@ void LCD_Task(void *parameter)
                             status_screen_idx = STATUS_START_IDX;
                         }
                     }
+
+                    // Draw the new second right away. Restarting the timer keeps the intermediate
+                    // scroll refresh half a period after this edge.
+                    xTimerReset(refresh_timer, 0);
+                    refresh = true;
                     break;
                 }
                 case TASK_CMD_SHUTDOWN:
@@ -475,19 +512,7 @@ void LCD_Task(void *parameter)
                 }
                 case TASK_CMD_REFRESH_LCD:
                 {
-                    if (use_display == false)
-                    {
-                        continue;
-                    }
-
-                    if (operating_state == MODE_NORMAL)
-                    {
-                        LCD_print_default_displays(time_print_buff, status_screen_idx, lock_state_local);
-                    }
-                    else
-                    {
-                        LCD_print_commissioning_displays(&operating_state);
-                    }
+                    refresh = true;
                     break;
                 }
                 case TASK_CMD_BTN_PRESS:
@@ -500,6 +525,8 @@ void LCD_Task(void *parameter)
                             int step = (operating_state == COMM_MASTER_ADVANCE_WAIT_MIN) ? 1 : 60;
                             rm.current_minutes_12o_clock += step;
                             rm.current_minutes_12o_clock %= MINUTES_PER_12H;
+                            JOURNAL_record_position(rm.current_minutes_12o_clock);
+                            MIRROR_checkpoint();
                             operating_state++; // set to execution state
                         }
                         else if (operating_state == COMM_SLAVE_ADVANCE_MIN || operating_state == COMM_SLAVE_ADVANCE_HOUR)
@@ -542,5 +569,25 @@ void LCD_Task(void *parameter)
                 }
             }
         }
+
+        if (refresh == false || use_display == false)
+        {
+            continue;
+        }
+
+        if (operating_state == MODE_NORMAL)
+        {
+            TRACE_BEGIN(TRACE_ID_LCD_DEFAULT_DISPLAYS);
+            LCD_print_default_displays(time_print_buff, status_screen_idx, lock_state_local, provisional);
+            TRACE_END(TRACE_ID_LCD_DEFAULT_DISPLAYS);
+
+            // error of the displayed second against the tick it belongs to, once the bus manager sent it
+            LCD_I2C_record_write_latency(time_tick_us);
+            time_tick_us = 0; // further refreshes show the same second
+        }
+        else
+        {
+            LCD_print_commissioning_displays(&operating_state);
+        }
     }
 }
@@ -7,33 +7,16 @@
 #include "LCM1602.h"
 #include <stdio.h>
 
-#include "driver/i2c_master.h" // for i2c_master_bus_config_t
-#include "rom/ets_sys.h"       // for microsecond delay
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h" // for vTaskDelay
+#include "i2c_bus.h"
 #include "bsp.h"
+#include "latency.h"
 
 #include "custom_main.h"
 
 
-static uint32_t max_wait_ticks = MAX_WAIT_TICKS; // amount of ticks to wait for blocking read/write
-const i2c_master_bus_config_t bus_conf =
-{
-	.clk_source = I2C_CLK_SRC_DEFAULT,
-	.i2c_port = I2C_PORT_NUM,
-	.scl_io_num = I2C_SCL_IO,
-	.sda_io_num = I2C_SDA_IO,
-	.glitch_ignore_cnt = 7,
-	.flags.enable_internal_pullup = true,
-};
-
-const i2c_device_config_t dev_conf =
-{
-	.dev_addr_length = I2C_ADDR_BIT_LEN_7,
-	.device_address = LCM1602_ADDR,
-	.scl_speed_hz = I2C_FREQ_HZ
-};
-
-static i2c_master_bus_handle_t bus_handle;
-static i2c_master_dev_handle_t dev_handle;
+static i2c_bus_dev_handle_t dev_handle;
 
 static uint8_t _backlight_on = true;
 static uint8_t _displayfunction;
@@ -44,13 +27,102 @@ static uint8_t _displaymode; // Text entry mode to the LCD
 static uint8_t _numlines; // Number of lines of the LCD, initialized with begin()
 static uint8_t _cols;     // Number of columns in the LCD
 
+// Shadow framebuffer: what the renderers want to show and what is currently on the display.
+// Only the differences get transferred on flush.
+static char _framebuffer[LCD_MAX_ROWS][LCD_MAX_COLS];
+static char _shadow[LCD_MAX_ROWS][LCD_MAX_COLS];
+static uint8_t _cursor_col, _cursor_row; // DDRAM address counter, as far as we know it
+static bool _cursor_known;
+
+// The PCF8574 byte sequence (EN high/low pairs) is collected here and sent as one transaction.
+// At I2C_FREQ_HZ every byte takes ~90us on the bus, which already exceeds the HD44780 enable pulse
+// width and the execution time of normal commands, so no CPU delays are needed in between.
+// Transfers run asynchronously via the bus manager: while one buffer is on the bus, the next one gets filled.
+static uint8_t _tx_buf[LCD_TX_NUM_BUFS][LCD_TX_BUF_LEN];
+static uint8_t _tx_idx; // buffer currently being filled
+static size_t _tx_len;
+
+// Completion tracking for the write latency, the transfers finish in I2C_BUS_Task
+static portMUX_TYPE _done_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t _tx_submitted;
+static uint32_t _tx_done;
+static int64_t _tx_last_done_us;
+static uint32_t _latency_seq; // transfer which completes the marked write, valid if _latency_tick_us != 0
+static int64_t _latency_tick_us;
+
 // General LCD commands - generic methods used by the rest of the commands
 // ---------------------------------------------------------------------------
 
+// Hands the filled buffer to the bus manager and switches to the next one. Only blocks (without
+// spinning) if the previous transfer, which used the next buffer, is not yet done.
+// A failed previous transfer is reported, but the new buffer is still submitted: I2C_BUS_wait() keeps
+// returning the result of the last transfer, skipping the submit would report the same error forever.
+static esp_err_t tx_commit(void)
+{
+   esp_err_t err = ESP_OK;
+   if (_tx_len > 0)
+   {
+      esp_err_t prev_err = I2C_BUS_wait(dev_handle, LCD_TX_TIMEOUT_MS); // result of the previous transfer
+      err = I2C_BUS_submit(dev_handle, _tx_buf[_tx_idx], _tx_len, NULL, 0); // times out if still busy
+      _tx_idx = (_tx_idx + 1) % LCD_TX_NUM_BUFS;
+      if (err == ESP_OK)
+      {
+         portENTER_CRITICAL(&_done_mux);
+         _tx_submitted++;
+         portEXIT_CRITICAL(&_done_mux);
+         err = prev_err;
+      }
+      _tx_len = 0;
+   }
+
+   if (err != ESP_OK)
+   { // unclear what reached the display, resend everything on the next flush
+      memset(_shadow, 0, sizeof(_shadow));
+      _cursor_known = false;
+   }
+   return err;
+}
+
+static void tx_done(void* arg, esp_err_t result, int64_t done_us)
+{
+   portENTER_CRITICAL(&_done_mux);
+   _tx_done++;
+   _tx_last_done_us = done_us;
+   if (_latency_tick_us != 0 && _tx_done == _latency_seq)
+   {
+      LATENCY_record_us(LATENCY_STAGE_LCD_WRITE, done_us - _latency_tick_us);
+      _latency_tick_us = 0;
+   }
+   portEXIT_CRITICAL(&_done_mux);
+}
+
+static esp_err_t tx_append(uint8_t data)
+{
+   esp_err_t err = ESP_OK;
+   if (_tx_len >= LCD_TX_BUF_LEN)
+   {
+      err = tx_commit(); // should not happen with row sized transfers
+   }
+   _tx_buf[_tx_idx][_tx_len++] = data;
+   return err;
+}
+
+// Commits and waits until the display received everything, e.g. before a timed wait
+static esp_err_t tx_wait_done(void)
+{
+   esp_err_t err = tx_commit();
+   if (err == ESP_OK)
+   {
+      err = I2C_BUS_wait(dev_handle, LCD_TX_TIMEOUT_MS);
+   }
+   return err;
+}
 
-static esp_err_t i2c_write(uint8_t data)
+// Blocks the calling task (the CPU may sleep) until the display executed the last command
+static void wait_exec_us(uint32_t duration_us)
 {
-    return i2c_master_transmit(dev_handle, &data, 1, max_wait_ticks);
+   tx_wait_done();
+   vTaskDelay(pdMS_TO_TICKS((duration_us + 999) / 1000) + 1); // +1: the current tick is already partly over
 }
 
 static esp_err_t writeNibble(uint8_t value, uint8_t mode)
@@ -64,15 +136,12 @@ static esp_err_t writeNibble(uint8_t value, uint8_t mode)
     // Shift nibble on D4-D7
     data |= (value & 0x0F) << 4;
 
-    // Enable = HIGH
-    err = i2c_write(data | PIN_EN);
+    // Enable = HIGH, data is latched on the falling edge
+    err = tx_append(data | PIN_EN);
     if (err == ESP_OK)
     {
-       ets_delay_us(1);
-   
        // Enable = LOW
-       err = i2c_write(data & ~PIN_EN);
-       ets_delay_us(50);
+       err = tx_append(data & ~PIN_EN);
     }
     return err;
 }
@@ -95,30 +164,31 @@ static esp_err_t send(uint8_t value, uint8_t mode)
 
 static esp_err_t command(uint8_t value)
 {
-   return send(value, COMMAND);
+   esp_err_t err = send(value, COMMAND);
+   if (err == ESP_OK)
+   {
+      err = tx_commit();
+   }
+   return err;
 }
 
 esp_err_t LCD_I2C_begin(uint8_t cols, uint8_t lines)
 {
-    esp_err_t ret = i2c_new_master_bus(&bus_conf, &bus_handle);
+	// the display is not time critical, let other bus clients go first
+	esp_err_t ret = I2C_BUS_add_device(LCM1602_ADDR, I2C_BUS_PRIO_LOW, "LCD", &dev_handle);
 	if (ret != ESP_OK)
 	{
-		PRINT_LOG("Unable add new master: %d", ret);
+		PRINT_LOG("Unable to add new device: %d", ret);
 	}
-
-	if (ret == ESP_OK)
+	else
 	{
-		ret = i2c_master_bus_add_device(bus_handle, &dev_conf, &dev_handle);
-		if (ret != ESP_OK)
-		{
-			PRINT_LOG("Unable to add new device: %d", ret);
-		}
+		I2C_BUS_set_done_cb(dev_handle, tx_done, NULL);
 	}
 
 	if (ret == ESP_OK)
 	{
 		// probe just for good measure
-		ret = i2c_master_probe(bus_handle, dev_conf.device_address, max_wait_ticks);
+		ret = I2C_BUS_probe(LCM1602_ADDR);
 		if (ret != ESP_OK)
 		{
 			PRINT_LOG("Probe failed: %d", ret);
@@ -133,8 +203,8 @@ esp_err_t LCD_I2C_begin(uint8_t cols, uint8_t lines)
 		{
 			_displayfunction |= LCD_2LINE;
 		}
-		_numlines = lines;
-		_cols = cols;
+		_numlines = (lines > LCD_MAX_ROWS) ? LCD_MAX_ROWS : lines;
+		_cols = (cols > LCD_MAX_COLS) ? LCD_MAX_COLS : cols;
 
 		// SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!
 		// according to datasheet, we need at least 40ms after power rises above 2.7V
@@ -151,23 +221,23 @@ esp_err_t LCD_I2C_begin(uint8_t cols, uint8_t lines)
 		// we start in 8bit mode, try to set 4 bit mode
 		// Special case of "Function Set"
 		send(0x03, FOUR_BITS);
-		ets_delay_us(4500); // wait min 4.1ms
+		wait_exec_us(4500); // wait min 4.1ms
 
-		// second try
+		// second try, the following ones need min 100us in between, which the
+		// address and EN high byte of the next transfer already take on the bus
 		send(0x03, FOUR_BITS);
-		ets_delay_us(150); // wait min 100us
+		tx_commit();
 
 		// third go!
 		send(0x03, FOUR_BITS);
-		ets_delay_us(150); // wait min of 100us
+		tx_commit();
 
 		// finally, set to 4-bit interface
 		send(0x02, FOUR_BITS);
-		ets_delay_us(150); // wait min of 100us
+		tx_commit();
 
 		// finally, set # lines, font size, etc.
 		command(LCD_FUNCTIONSET | _displayfunction);
-		ets_delay_us(60); // wait more
 
 		// turn the display on with no cursor or blinking default
 		_displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
@@ -187,10 +257,29 @@ esp_err_t LCD_I2C_begin(uint8_t cols, uint8_t lines)
 	return ret;
 }
 
-static size_t write(uint8_t value)
+// Queues a character for DDRAM and keeps the shadow in sync with it, sent with the next tx_commit()
+static esp_err_t write_ddram(char value)
 {
    esp_err_t err = send(value, LCD_DATA);
-   return err == ESP_OK ? 1 : 0;
+   if (err != ESP_OK)
+   {
+      _cursor_known = false; // unclear if the display got it
+   }
+   else if (_cursor_known && _cursor_col < _cols)
+   {
+      _shadow[_cursor_row][_cursor_col] = value;
+      _cursor_col++;
+   }
+   return err;
+}
+
+static void reset_shadow(void)
+{
+   memset(_shadow, ' ', sizeof(_shadow));
+   memset(_framebuffer, ' ', sizeof(_framebuffer));
+   _cursor_col = 0;
+   _cursor_row = 0;
+   _cursor_known = true;
 }
 
 // Common LCD Commands
@@ -204,29 +293,39 @@ esp_err_t LCD_I2C_print(const char *str)
 
    for (uint8_t idx = 0; idx < len; idx++)
    {
-      err = send(str[idx], LCD_DATA);
+      err = write_ddram(str[idx]);
       if (err != ESP_OK)
       {
          break;
       }
    }
 
+   if (err == ESP_OK)
+   {
+      err = tx_commit(); // whole string in one transaction
+   }
+
    return err;
 }
 
 void LCD_I2C_clear()
 {
    command(LCD_CLEARDISPLAY);     // clear display, set cursor position to zero
-   ets_delay_us(HOME_CLEAR_EXEC); // this command is time consuming
+   wait_exec_us(HOME_CLEAR_EXEC); // this command is time consuming
+   reset_shadow();                // display now only contains spaces
 }
 
 void LCD_I2C_home()
 {
    command(LCD_RETURNHOME);       // set cursor position to zero
-   ets_delay_us(HOME_CLEAR_EXEC); // This command is time consuming
+   wait_exec_us(HOME_CLEAR_EXEC); // This command is time consuming
+   _cursor_col = 0;
+   _cursor_row = 0;
+   _cursor_known = true;
 }
 
-void LCD_I2C_setCursor(uint8_t col, uint8_t row)
+// Queues the DDRAM address command, sent with the next tx_commit()
+static esp_err_t set_cursor(uint8_t col, uint8_t row)
 {
    const uint8_t row_offsetsDef[] = {0x00, 0x40, 0x14, 0x54};   // For regular LCDs
    const uint8_t row_offsetsLarge[] = {0x00, 0x40, 0x10, 0x50}; // For 16x4 LCDs
@@ -236,15 +335,27 @@ void LCD_I2C_setCursor(uint8_t col, uint8_t row)
       row = _numlines - 1; // rows start at 0
    }
 
+   _cursor_col = col;
+   _cursor_row = row;
+   _cursor_known = true;
+
    // 16x4 LCDs have special memory map layout
    // ----------------------------------------
    if (_cols == 16 && _numlines == 4)
    {
-      command(LCD_SETDDRAMADDR | (col + row_offsetsLarge[row]));
+      return send(LCD_SETDDRAMADDR | (col + row_offsetsLarge[row]), COMMAND);
    }
    else
    {
-      command(LCD_SETDDRAMADDR | (col + row_offsetsDef[row]));
+      return send(LCD_SETDDRAMADDR | (col + row_offsetsDef[row]), COMMAND);
+   }
+}
+
+void LCD_I2C_setCursor(uint8_t col, uint8_t row)
+{
+   if (set_cursor(col, row) == ESP_OK)
+   {
+      tx_commit();
    }
 }
 
@@ -315,12 +426,14 @@ void LCD_I2C_rightToLeft(void)
 void LCD_I2C_moveCursorRight(void)
 {
    command(LCD_CURSORSHIFT | LCD_CURSORMOVE | LCD_MOVERIGHT);
+   _cursor_known = false;
 }
 
 // This method moves the cursor one space to the left
 void LCD_I2C_moveCursorLeft(void)
 {
    command(LCD_CURSORSHIFT | LCD_CURSORMOVE | LCD_MOVELEFT);
+   _cursor_known = false;
 }
 
 // This will 'right justify' text from the cursor
@@ -342,14 +455,14 @@ void LCD_I2C_createChar(uint8_t location, const uint8_t charmap[])
 {
    location &= 0x7; // we only have 8 locations 0-7
 
-   command(LCD_SETCGRAMADDR | (location << 3));
-   ets_delay_us(30);
+   send(LCD_SETCGRAMADDR | (location << 3), COMMAND);
+   _cursor_known = false; // address counter now points into CGRAM
 
    for (uint8_t i = 0; i < 8; i++)
    {
-      write(charmap[i]); // call the virtual write method
-      ets_delay_us(40);
+      send(charmap[i], LCD_DATA);
    }
+   tx_commit(); // address and pattern in one transaction
 }
 
 void LCD_I2C_backlight(uint8_t on)
@@ -357,3 +470,67 @@ void LCD_I2C_backlight(uint8_t on)
    _backlight_on = on;
 }
 
+// Write into the framebuffer only, nothing is sent until LCD_I2C_flush()
+void LCD_I2C_fbWrite(uint8_t col, uint8_t row, const char *str)
+{
+   if (row >= _numlines)
+   {
+      return;
+   }
+
+   for (; col < _cols && *str; col++, str++)
+   {
+      _framebuffer[row][col] = *str;
+   }
+}
+
+// Send all cells which differ from what is on the display, only moving the cursor where needed
+esp_err_t LCD_I2C_flush(void)
+{
+   esp_err_t err = ESP_OK;
+
+   for (uint8_t row = 0; row < _numlines && err == ESP_OK; row++)
+   {
+      for (uint8_t col = 0; col < _cols && err == ESP_OK; col++)
+      {
+         if (_framebuffer[row][col] == _shadow[row][col])
+         {
+            continue;
+         }
+
+         if (!_cursor_known || _cursor_row != row || _cursor_col != col)
+         {
+            err = set_cursor(col, row);
+         }
+         if (err == ESP_OK)
+         {
+            err = write_ddram(_framebuffer[row][col]);
+         }
+      }
+
+      if (err == ESP_OK)
+      {
+         err = tx_commit(); // one transaction per row
+      }
+   }
+
+   return err;
+}
+
+void LCD_I2C_record_write_latency(int64_t tick_us)
+{
+   if (tick_us <= 0) // refresh not caused by a tick
+      return;
+
+   portENTER_CRITICAL(&_done_mux);
+   if (_tx_done == _tx_submitted)
+   { // already on the display, or nothing had to be sent
+      LATENCY_record_us(LATENCY_STAGE_LCD_WRITE, (_tx_last_done_us > tick_us) ? _tx_last_done_us - tick_us : 0);
+   }
+   else
+   { // tx_done() records it with the last transfer queued so far
+      _latency_seq = _tx_submitted;
+      _latency_tick_us = tick_us;
+   }
+   portEXIT_CRITICAL(&_done_mux);
+}
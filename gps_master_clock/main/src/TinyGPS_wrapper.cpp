@@ -18,13 +18,15 @@ int TinyGPS_wrapper_crack_datetime(struct tm* local, time_t* utc, uint32_t* age)
     struct tm tim;
     uint8_t hundredths, month, day, hour, min, sec;
     int year;
+    unsigned long fix_age; // not uint32_t on every platform, e.g. the host tests
 
-    gps.crack_datetime(&year, &month, &day, &hour, &min, &sec, &hundredths, age);
+    gps.crack_datetime(&year, &month, &day, &hour, &min, &sec, &hundredths, &fix_age);
 
-    if (*age == TinyGPS::GPS_INVALID_AGE)
+    if (fix_age == TinyGPS::GPS_INVALID_AGE)
     {
         return -1;
     }
+    *age = fix_age;
 
     // general sanity checks
     if (month > 12 || day > 31 || hour > 23 || min > 59 || sec > 59)
@@ -62,3 +64,25 @@ int TinyGPS_wrapper_crack_datetime(struct tm* local, time_t* utc, uint32_t* age)
 
     return 0;
 }
+
+int TinyGPS_wrapper_get_position(int32_t* lat_e7, int32_t* lon_e7, int32_t* alt_cm, uint32_t* age)
+{
+    long lat, lon;
+    unsigned long fix_age;
+
+    gps.get_position(&lat, &lon, &fix_age); // in 1e-5 degrees
+
+    if (fix_age == TinyGPS::GPS_INVALID_AGE || lat == TinyGPS::GPS_INVALID_ANGLE || lon == TinyGPS::GPS_INVALID_ANGLE)
+    {
+        return -1;
+    }
+    *age = fix_age;
+
+    *lat_e7 = lat * 100;
+    *lon_e7 = lon * 100;
+
+    long alt = gps.altitude();
+    *alt_cm = (alt == TinyGPS::GPS_INVALID_ALTITUDE) ? TINYGPS_WRAPPER_INVALID_ALTITUDE : alt;
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "clocksync.h"
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+clocksync_action_t CLOCKSYNC_minute_sync(int face_minutes, int target_minutes, bool provisional, int* minutes)
+{
+    // the dial repeats every 12h: the target is always reached by moving forward, or the face is ahead by the rest
+    int forward = ((target_minutes - face_minutes) % MINUTES_PER_12H + MINUTES_PER_12H) % MINUTES_PER_12H;
+    int lead = MINUTES_PER_12H - forward;
+
+    if (forward == 0)
+    {
+        *minutes = 0;
+        return CLOCKSYNC_IN_SYNC;
+    }
+
+    // caution around 12'o clock position: if our local time is 00:00 or after, and the
+    // received GPS time is before 00:00 -> large difference, where it would make sense to wait!
+    if (lead <= MAX_LOCAL_CLOCK_LEAD_MINUTES)
+    {
+        *minutes = lead;
+        return CLOCKSYNC_WAIT_LEAD;
+    }
+
+    if (forward <= lead) // behind, e.g. 11:59 -> 12:00 is one minute forward
+    {
+        *minutes = forward;
+        return CLOCKSYNC_ADVANCE;
+    }
+
+    // the face is ahead by more than the allowed lead, can not set counter clockwise difference
+    if (provisional)
+    { // the estimate could be wrong, a wrap around takes ages -> wait for GPS
+        *minutes = lead;
+        return CLOCKSYNC_WAIT_PROVISIONAL;
+    }
+    *minutes = forward; // need to wrap around, all the way forward to the target
+    return CLOCKSYNC_WRAP_AROUND;
+}
+
+bool CLOCKSYNC_minute_crossed(time_t previous_utc, time_t utc)
+{
+    if (previous_utc == 0 || utc <= previous_utc) // nothing to compare to, or the time was set back
+    {
+        return (utc % 60) == 0;
+    }
+    return (utc / 60) != (previous_utc / 60);
+}
+
+bool CLOCKSYNC_drift_correction(time_t clock_diff_s, bool provisional, uint32_t* total_pos_s, uint32_t* total_neg_s)
+{
+    if (clock_diff_s <= MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS && clock_diff_s >= -MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS)
+    {
+        return false;
+    }
+
+    // Accumulate the total drifted time into separate counters
+    if (provisional)
+    {
+        // not drift, just the error of the estimate
+    }
+    else if (clock_diff_s > 0)
+    {
+        *total_pos_s += clock_diff_s;
+    }
+    else
+    {
+        *total_neg_s += -clock_diff_s;
+    }
+    return true;
+}
+
+bool CLOCKSYNC_anchor_utc(time_t anchor_utc, uint64_t anchor_rtc_us, uint64_t now_rtc_us, time_t* utc)
+{
+    uint64_t elapsed_s = (now_rtc_us - anchor_rtc_us + 500000) / 1000000; // round to full seconds
+    if (now_rtc_us < anchor_rtc_us || elapsed_s > MAX_ANCHOR_AGE_S)
+    {
+        return false;
+    }
+    *utc = anchor_utc + elapsed_s;
+    return true;
+}
@@ -0,0 +1,104 @@
+#include "deepsleep.h"
+
+#include "esp_sleep.h"
+#include "esp_wake_stub.h"
+#include "esp_rtc_time.h"
+#include "esp_system.h" // for reset reason
+#include "driver/gpio.h"
+#include "soc/gpio_reg.h"
+#include "soc/io_mux_reg.h"
+
+#include "bsp.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define POLL_PERIOD_US      1000000 // sampling of power good while in deep sleep
+#define GOOD_POLLS_REQUIRED 10      // power good has to be stable for 10s, like while running
+#define SLEEP_STATE_MAGIC   0x50454C53 // "SLEP"
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint32_t magic; // set while in the power fail mode
+    uint32_t polls;
+    uint32_t good_polls; // consecutive
+    uint64_t start_rtc_us;
+} sleep_state_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+// RTC slow memory, kept in deep sleep and accessible by the wake stub
+static RTC_DATA_ATTR sleep_state_t sleep_state;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+/* Runs from RTC fast memory right after each wakeup, before the bootloader. Flash and DRAM are not
+ * available here, only registers and RTC memory. A poll takes well below 1ms, booting the application
+ * would take ~300ms at ~40mA. */
+static void RTC_IRAM_ATTR wake_stub(void)
+{
+    PIN_INPUT_ENABLE(POWER_GOOD_IO_MUX_REG); // the IO MUX was reset with the digital domain
+
+    sleep_state.polls++;
+    if (REG_READ(GPIO_IN_REG) & BIT(POWER_GOOD_IO))
+    {
+        sleep_state.good_polls++;
+    }
+    else
+    {
+        sleep_state.good_polls = 0;
+    }
+
+    if (sleep_state.good_polls < GOOD_POLLS_REQUIRED)
+    {
+        esp_wake_stub_set_wakeup_time(POLL_PERIOD_US);
+        esp_wake_stub_sleep(&wake_stub); // does not return
+    }
+    esp_default_wake_deep_sleep(); // power is back, boot normally
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void DEEPSLEEP_enter(void)
+{
+    sleep_state.polls = 0;
+    sleep_state.good_polls = 0;
+    sleep_state.start_rtc_us = esp_rtc_get_time_us();
+    sleep_state.magic = SLEEP_STATE_MAGIC;
+
+    // the digital pads are released in deep sleep, keep the pulse output inactive
+    gpio_set_level(GPIO_LED, 0);
+    gpio_hold_en(GPIO_LED);
+    gpio_deep_sleep_hold_en();
+
+    esp_set_deep_sleep_wake_stub(&wake_stub);
+    esp_sleep_enable_timer_wakeup(POLL_PERIOD_US);
+    esp_deep_sleep_start();
+}
+
+bool DEEPSLEEP_woke_up(uint64_t* slept_us, uint32_t* polls)
+{
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP || sleep_state.magic != SLEEP_STATE_MAGIC)
+        return false;
+
+    sleep_state.magic = 0;
+    *slept_us = esp_rtc_get_time_us() - sleep_state.start_rtc_us;
+    *polls = sleep_state.polls;
+
+    // take over the pulse output before releasing the hold
+    gpio_set_direction(GPIO_LED, GPIO_MODE_INPUT_OUTPUT);
+    gpio_set_level(GPIO_LED, 0);
+    gpio_deep_sleep_hold_dis();
+    gpio_hold_dis(GPIO_LED);
+    return true;
+}
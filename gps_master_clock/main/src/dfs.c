@@ -0,0 +1,190 @@
+#include "dfs.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_pm.h"
+#include "esp_clk_tree.h"
+#include "sdkconfig.h"
+
+#include "custom_main.h"
+#include "trace.h"
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    DFS_LEVEL_MIN,     // no lock held: minimum frequency (or light sleep, if enabled)
+    DFS_LEVEL_APB_MAX, // only APB locks held
+    DFS_LEVEL_CPU_MAX, // CPU lock held
+    NUM_DFS_LEVEL
+} dfs_level_t;
+
+//---------------------------------------------------------------------------
+// Local constants
+//---------------------------------------------------------------------------
+
+static const struct
+{
+    esp_pm_lock_type_t type;
+    const char* name;
+} lock_conf[NUM_DFS_LOCK] =
+{
+    [DFS_LOCK_GPS_PARSE]    = { ESP_PM_CPU_FREQ_MAX, "gps_parse" },
+    [DFS_LOCK_PULSE]        = { ESP_PM_APB_FREQ_MAX, "pulse" },
+    [DFS_LOCK_I2C]          = { ESP_PM_APB_FREQ_MAX, "i2c" },
+};
+
+static const char* const level_names[NUM_DFS_LEVEL] =
+{
+    [DFS_LEVEL_MIN]     = "no lock",
+    [DFS_LEVEL_APB_MAX] = "APB lock",
+    [DFS_LEVEL_CPU_MAX] = "CPU lock",
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static esp_pm_lock_handle_t locks[NUM_DFS_LOCK];
+static bool held[NUM_DFS_LOCK];
+static uint32_t acquired_cnt[NUM_DFS_LOCK];
+
+static portMUX_TYPE dfs_mux = portMUX_INITIALIZER_UNLOCKED;
+static dfs_level_t level = DFS_LEVEL_MIN;
+static int64_t level_since_us;
+static int64_t lock_residency_us[NUM_DFS_LEVEL];
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// call with dfs_mux taken
+static void update_level(void)
+{
+    dfs_level_t new_level = DFS_LEVEL_MIN;
+    for (uint8_t idx = 0; idx < NUM_DFS_LOCK; idx++)
+    {
+        if (held[idx] && lock_conf[idx].type == ESP_PM_CPU_FREQ_MAX)
+        {
+            new_level = DFS_LEVEL_CPU_MAX;
+        }
+        else if (held[idx] && new_level == DFS_LEVEL_MIN)
+        {
+            new_level = DFS_LEVEL_APB_MAX;
+        }
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    lock_residency_us[level] += now_us - level_since_us;
+    level_since_us = now_us;
+    level = new_level;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+esp_err_t DFS_init(void)
+{
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = DFS_MAX_FREQ_MHZ,
+#if TRACE_ENABLE
+        .min_freq_mhz = DFS_MAX_FREQ_MHZ, // the trace timestamps are CPU cycles, they need a fixed frequency
+#else
+        .min_freq_mhz = DFS_MIN_FREQ_MHZ,
+#endif // TRACE_ENABLE
+        .light_sleep_enable = DFS_LIGHT_SLEEP,
+    };
+
+    esp_err_t err = esp_pm_configure(&pm_config);
+    for (uint8_t idx = 0; idx < NUM_DFS_LOCK && err == ESP_OK; idx++)
+    {
+        err = esp_pm_lock_create(lock_conf[idx].type, 0, lock_conf[idx].name, &locks[idx]);
+    }
+    level_since_us = esp_timer_get_time();
+    return err;
+}
+
+void DFS_acquire(dfs_lock_t lock)
+{
+    if (lock >= NUM_DFS_LOCK || locks[lock] == NULL || held[lock])
+        return;
+
+    esp_pm_lock_acquire(locks[lock]);
+    portENTER_CRITICAL(&dfs_mux);
+    held[lock] = true;
+    acquired_cnt[lock]++;
+    update_level();
+    portEXIT_CRITICAL(&dfs_mux);
+}
+
+void DFS_release(dfs_lock_t lock)
+{
+    if (lock >= NUM_DFS_LOCK || locks[lock] == NULL || !held[lock])
+        return;
+
+    portENTER_CRITICAL(&dfs_mux);
+    held[lock] = false;
+    update_level();
+    portEXIT_CRITICAL(&dfs_mux);
+    esp_pm_lock_release(locks[lock]);
+}
+
+void DFS_print_stats(void)
+{
+    int64_t lock_residency_copy[NUM_DFS_LEVEL];
+    int64_t total_us = 0;
+
+    portENTER_CRITICAL(&dfs_mux);
+    update_level(); // account the current level up to now
+    for (uint8_t idx = 0; idx < NUM_DFS_LEVEL; idx++)
+    {
+        lock_residency_copy[idx] = lock_residency_us[idx];
+        total_us += lock_residency_us[idx];
+    }
+    portEXIT_CRITICAL(&dfs_mux);
+
+    if (total_us == 0)
+        return;
+
+    // what is configured, not the constants, stays 0/0 without CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = { 0 };
+    esp_pm_get_configuration(&pm_config);
+    uint32_t cpu_hz = 0;
+    esp_clk_tree_src_get_freq_hz(SOC_MOD_CLK_CPU, ESP_CLK_TREE_SRC_FREQ_PRECISION_CACHED, &cpu_hz);
+
+    /* CPU frequency per lock level. The ESP32 can not switch between 240MHz and 80/160MHz without turning the
+     * PLL off, so ESP-IDF runs an APB lock at 240MHz if that is the maximum (esp_pm_configure) */
+    int level_mhz[NUM_DFS_LEVEL] =
+    {
+        [DFS_LEVEL_MIN]     = pm_config.min_freq_mhz,
+        [DFS_LEVEL_APB_MAX] = (pm_config.max_freq_mhz == 240) ? 240 : 80,
+        [DFS_LEVEL_CPU_MAX] = pm_config.max_freq_mhz,
+    };
+
+    PRINT_LOG("DFS configured %d/%dMHz, light sleep %d, CPU now %luMHz, locks acquired: gps_parse %lu, pulse %lu, i2c %lu",
+        pm_config.max_freq_mhz, pm_config.min_freq_mhz, pm_config.light_sleep_enable, cpu_hz / 1000000,
+        acquired_cnt[DFS_LOCK_GPS_PARSE], acquired_cnt[DFS_LOCK_PULSE], acquired_cnt[DFS_LOCK_I2C]);
+
+    // time each lock level was held and the frequency it results in, with light sleep the no lock time includes it
+    PRINT_LOG("DFS lock time per frequency:");
+    for (uint8_t idx = 0; idx < NUM_DFS_LEVEL; idx++)
+    {
+        uint32_t permille = lock_residency_copy[idx] * 1000 / total_us;
+        PRINT_LOG("\t%-8s %3dMHz %10lldms %3lu.%lu%%", level_names[idx], level_mhz[idx],
+            lock_residency_copy[idx] / 1000, permille / 10, permille % 10);
+    }
+
+#if CONFIG_PM_PROFILING
+    // the actual time per power management mode, including light sleep
+    if (xUartSemaphore != NULL && xSemaphoreTake(xUartSemaphore, portMAX_DELAY) == pdTRUE)
+    {
+        esp_pm_dump_locks(stdout);
+        fflush(stdout);
+        xSemaphoreGive(xUartSemaphore);
+    }
+#endif // CONFIG_PM_PROFILING
+}
@@ -0,0 +1,181 @@
+#include "drift.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h" // for vTaskDelay
+
+#include "custom_main.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define DUMP_CHUNK_LINES 16 // CSV lines per UART mutex hold, the other tasks can log in between
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint32_t utc;      // GPS second of the sample
+    int32_t offset_us; // local timebase minus GPS, relative to the first sample. Positive: local runs fast
+} drift_sample_t;
+
+typedef struct
+{
+    drift_sample_t samples[DRIFT_NUM_SAMPLES];
+    uint16_t head; // next index to write
+    uint16_t cnt;  // valid samples
+    uint32_t interval_s; // all samples are on this grid, so their spacing is uniform
+} drift_buf_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static drift_buf_t buf = { .interval_s = 1 };
+static drift_buf_t dump_buf; // copy of buf, printed without holding up the recording
+static portMUX_TYPE drift_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool have_base;
+static time_t base_utc;
+static int64_t base_us;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// idx 0 is the oldest sample
+static const drift_sample_t* get_sample(const drift_buf_t* b, uint16_t idx)
+{
+    return &b->samples[(b->head + DRIFT_NUM_SAMPLES - b->cnt + idx) % DRIFT_NUM_SAMPLES];
+}
+
+// drop every other sample, the buffer is linear (not yet wrapped) until the max interval is reached
+static void decimate(void)
+{
+    uint16_t kept = 0;
+    buf.interval_s *= 2;
+    for (uint16_t idx = 0; idx < buf.cnt; idx++)
+    {
+        if (buf.samples[idx].utc % buf.interval_s == 0)
+        {
+            buf.samples[kept++] = buf.samples[idx];
+        }
+    }
+    buf.cnt = kept;
+    buf.head = kept;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void DRIFT_record(time_t utc, int64_t local_us)
+{
+    if (!have_base)
+    {
+        base_utc = utc;
+        base_us = local_us;
+        have_base = true;
+    }
+
+    int64_t offset_us = (local_us - base_us) - (int64_t)(utc - base_utc) * 1000000;
+
+    portENTER_CRITICAL(&drift_mux);
+    if (offset_us > INT32_MAX || offset_us < INT32_MIN)
+    { // > 35min off, GPS time jumped: start over
+        have_base = false;
+        buf.cnt = buf.head = 0;
+        buf.interval_s = 1;
+    }
+    else
+    {
+        if (buf.cnt == DRIFT_NUM_SAMPLES && buf.interval_s < DRIFT_MAX_INTERVAL_S)
+        {
+            decimate();
+        }
+
+        if (utc % buf.interval_s == 0)
+        {
+            buf.samples[buf.head].utc = utc;
+            buf.samples[buf.head].offset_us = offset_us;
+            buf.head = (buf.head + 1) % DRIFT_NUM_SAMPLES;
+            if (buf.cnt < DRIFT_NUM_SAMPLES)
+                buf.cnt++;
+        }
+    }
+    portEXIT_CRITICAL(&drift_mux);
+}
+
+void DRIFT_dump(void)
+{
+    const drift_buf_t* b = &dump_buf;
+
+    portENTER_CRITICAL(&drift_mux);
+    dump_buf = buf; // 2kB, a few us
+    portEXIT_CRITICAL(&drift_mux);
+
+    if (b->cnt < 2)
+        return;
+
+    // raw samples, can be copied to a file and fed to tools/drift_analysis.py, Stable32 or allantools
+    for (uint16_t idx = 0; idx < b->cnt; )
+    {
+        if (xUartSemaphore == NULL || xSemaphoreTake(xUartSemaphore, pdMS_TO_TICKS(MAX_LOG_WAIT_MS)) != pdTRUE)
+        {
+            vTaskDelay(1); // let the current log finish
+            continue;
+        }
+        if (idx == 0)
+        {
+            snprintf(print_buf, MAX_LOG_LEN, "utc,offset_us\n");
+            serial_print_custom();
+        }
+        for (uint16_t end = idx + DUMP_CHUNK_LINES; idx < b->cnt && idx < end; idx++)
+        {
+            const drift_sample_t* s = get_sample(b, idx);
+            snprintf(print_buf, MAX_LOG_LEN, "%lu,%ld\n", s->utc, s->offset_us);
+            serial_print_custom();
+        }
+        xSemaphoreGive(xUartSemaphore);
+    }
+
+    // mean frequency offset, us per s = ppm
+    const drift_sample_t* first = get_sample(b, 0);
+    const drift_sample_t* last = get_sample(b, b->cnt - 1);
+    double ppm = (double)(last->offset_us - first->offset_us) / (last->utc - first->utc);
+    PRINT_LOG("Drift: %.3lfppm over %lus (interval %lus), holdover until 1s off: %.1lfh",
+        ppm, last->utc - first->utc, b->interval_s, (ppm != 0) ? 1e6 / fabs(ppm) / 3600 : INFINITY);
+
+    /* Overlapping Allan deviation from the phase samples:
+     * adev(tau)^2 = 1 / (2 tau^2 (N - 2m)) * sum (x[i+2m] - 2x[i+m] + x[i])^2, with tau = m * interval.
+     * Triples spanning a gap (missing GPS seconds) are skipped. */
+    for (uint32_t m = 1; 2 * m < b->cnt; m *= 2)
+    {
+        uint32_t tau_s = m * b->interval_s;
+        double sum = 0;
+        uint32_t n = 0;
+
+        for (uint16_t idx = 0; idx + 2 * m < b->cnt; idx++)
+        {
+            const drift_sample_t* x0 = get_sample(b, idx);
+            const drift_sample_t* x1 = get_sample(b, idx + m);
+            const drift_sample_t* x2 = get_sample(b, idx + 2 * m);
+            if (x1->utc - x0->utc != tau_s || x2->utc - x1->utc != tau_s)
+                continue;
+
+            double d = (double)x2->offset_us - 2.0 * x1->offset_us + x0->offset_us;
+            sum += d * d;
+            n++;
+        }
+
+        if (n > 0)
+        {
+            PRINT_LOG("ADEV tau %6lus: %.2le (n=%lu)", tau_s, sqrt(sum / (2.0 * n)) / (tau_s * 1e6), n);
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#include "ds3231.h"
+
+#include <stdint.h>
+
+#include "i2c_bus.h"
+#include "bsp.h"
+
+#include "custom_main.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// register map
+#define REG_SECONDS     0x00
+#define REG_MINUTES     0x01
+#define REG_HOURS       0x02
+#define REG_DAY         0x03
+#define REG_DATE        0x04
+#define REG_MONTH       0x05
+#define REG_YEAR        0x06
+#define REG_STATUS      0x0F
+#define NUM_REGS        0x10 // everything up to and including the status register
+
+#define HOURS_12H       0x40 // 12 hour mode, we always write 24 hour mode
+#define MONTH_CENTURY   0x80 // year register overflowed
+#define STATUS_OSF      0x80 // oscillator stopped, time is not trustworthy
+
+#define BCD2BIN(x) ((((x) >> 4) * 10) + ((x) & 0x0F))
+#define BIN2BCD(x) ((((x) / 10) << 4) | ((x) % 10))
+
+#define SECONDS_PER_DAY (24 * 3600)
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static i2c_bus_dev_handle_t dev_handle;
+static bool present;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// Days since 1970-01-01 of a proleptic gregorian date. Avoids mktime(), which depends on the
+// global timezone setting (see take_tz_mutex()).
+static int64_t days_from_civil(int year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yoe = year - era * 400;
+    unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097LL + doe - 719468;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+esp_err_t DS3231_init(void)
+{
+    // reading the time is needed to get the clock going after a power loss -> before the display
+    esp_err_t ret = I2C_BUS_add_device(DS3231_ADDR, I2C_BUS_PRIO_HIGH, "RTC", &dev_handle);
+    if (ret == ESP_OK)
+    {
+        ret = I2C_BUS_probe(DS3231_ADDR);
+    }
+
+    present = (ret == ESP_OK);
+    PRINT_LOG("RTC %s", present ? "found" : "not found");
+    return ret;
+}
+
+bool DS3231_present(void)
+{
+    return present;
+}
+
+esp_err_t DS3231_read_utc(time_t* utc)
+{
+    static const uint8_t tx[] = { REG_SECONDS };
+    static uint8_t regs[NUM_REGS];
+
+    if (!present)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // read everything in one go, so the time registers are consistent
+    esp_err_t ret = I2C_BUS_transfer(dev_handle, tx, sizeof(tx), regs, sizeof(regs), I2C_BUS_MAX_TRANSACTION_MS);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    if (regs[REG_STATUS] & STATUS_OSF)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    unsigned hours;
+    if (regs[REG_HOURS] & HOURS_12H)
+    { // not written by us, but handle it anyway: bit 5 is PM, 12 is midnight/noon
+        hours = BCD2BIN(regs[REG_HOURS] & 0x1F) % 12 + ((regs[REG_HOURS] & 0x20) ? 12 : 0);
+    }
+    else
+    {
+        hours = BCD2BIN(regs[REG_HOURS] & 0x3F);
+    }
+
+    int year = 2000 + BCD2BIN(regs[REG_YEAR]) + ((regs[REG_MONTH] & MONTH_CENTURY) ? 100 : 0);
+    int64_t days = days_from_civil(year, BCD2BIN(regs[REG_MONTH] & 0x1F), BCD2BIN(regs[REG_DATE] & 0x3F));
+
+    *utc = days * SECONDS_PER_DAY + hours * 3600 +
+        BCD2BIN(regs[REG_MINUTES] & 0x7F) * 60 + BCD2BIN(regs[REG_SECONDS] & 0x7F);
+    return ESP_OK;
+}
+
+esp_err_t DS3231_write_utc(time_t utc)
+{
+    static uint8_t tx_time[1 + REG_YEAR + 1];
+    static const uint8_t tx_status[] = { REG_STATUS, 0x00 }; // clear OSF and alarm flags, disable 32kHz output
+    struct tm t;
+
+    if (!present)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    gmtime_r(&utc, &t);
+    int year = t.tm_year + 1900 - 2000; // the RTC counts 2000..2199
+    if (year < 0 || year >= 200)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    tx_time[0] = REG_SECONDS;
+    tx_time[1 + REG_SECONDS] = BIN2BCD(t.tm_sec);
+    tx_time[1 + REG_MINUTES] = BIN2BCD(t.tm_min);
+    tx_time[1 + REG_HOURS]   = BIN2BCD(t.tm_hour); // 24h mode
+    tx_time[1 + REG_DAY]     = t.tm_wday + 1;
+    tx_time[1 + REG_DATE]    = BIN2BCD(t.tm_mday);
+    tx_time[1 + REG_MONTH]   = BIN2BCD(t.tm_mon + 1) | ((year >= 100) ? MONTH_CENTURY : 0);
+    tx_time[1 + REG_YEAR]    = BIN2BCD(year % 100);
+
+    esp_err_t ret = I2C_BUS_transfer(dev_handle, tx_time, sizeof(tx_time), NULL, 0, I2C_BUS_MAX_TRANSACTION_MS);
+    if (ret == ESP_OK)
+    { // time is valid from now on
+        ret = I2C_BUS_transfer(dev_handle, tx_status, sizeof(tx_status), NULL, 0, I2C_BUS_MAX_TRANSACTION_MS);
+    }
+    return ret;
+}
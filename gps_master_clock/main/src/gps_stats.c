@@ -0,0 +1,242 @@
+#include "gps_stats.h"
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_rom_crc.h"
+
+#include "custom_main.h"
+
+//---------------------------------------------------------------------------
+// Local constants
+//---------------------------------------------------------------------------
+
+// upper bound of the buckets in seconds
+static const uint32_t outage_limits_s[NUM_GPS_OUTAGE - 1] =
+{
+    [GPS_OUTAGE_10S]   = 10,
+    [GPS_OUTAGE_1MIN]  = 60,
+    [GPS_OUTAGE_10MIN] = 10 * 60,
+    [GPS_OUTAGE_1H]    = 3600,
+    [GPS_OUTAGE_6H]    = 6 * 3600,
+    [GPS_OUTAGE_1D]    = 24 * 3600,
+};
+
+static const char* outage_names[NUM_GPS_OUTAGE] =
+{
+    [GPS_OUTAGE_10S]    = "<10s",
+    [GPS_OUTAGE_1MIN]   = "<1min",
+    [GPS_OUTAGE_10MIN]  = "<10min",
+    [GPS_OUTAGE_1H]     = "<1h",
+    [GPS_OUTAGE_6H]     = "<6h",
+    [GPS_OUTAGE_1D]     = "<1d",
+    [GPS_OUTAGE_LONGER] = ">=1d",
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+// same handling as the RAM mirror: not initialized by the bootloader, survives soft resets and is only
+// trusted afterwards if version, length and CRC match
+RTC_NOINIT_ATTR static gps_stats_t stats;
+RTC_NOINIT_ATTR static uint32_t stats_crc;
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool locked;
+static int64_t locked_since_us;  // start of the not yet accounted locked time
+static int64_t outage_start_us;  // 0 if no outage is running (the lock at boot is not an outage)
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static uint32_t calc_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t*)&stats, sizeof(stats));
+}
+
+// call within the critical section after modifying stats
+static void update_crc(void)
+{
+    stats_crc = calc_crc();
+}
+
+// move the full seconds of the current lock period into the counter, call within the critical section
+static void account_locked_time(int64_t now_us)
+{
+    if (locked)
+    {
+        uint32_t secs = (now_us - locked_since_us) / 1000000;
+        stats.locked_s += secs;
+        locked_since_us += secs * 1000000LL;
+        update_crc();
+    }
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void GPS_STATS_reset(void)
+{
+    portENTER_CRITICAL(&stats_mux);
+    stats = (gps_stats_t){ .version = GPS_STATS_VERSION, .len = sizeof(gps_stats_t) };
+    update_crc();
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+esp_err_t GPS_STATS_load(nvs_handle_t nvs_handle, bool soft_reset)
+{
+    esp_err_t err = ESP_OK;
+
+    if (soft_reset && stats.version == GPS_STATS_VERSION && stats.len == sizeof(gps_stats_t) &&
+        stats_crc == calc_crc())
+    { // RTC RAM is still valid
+        return ESP_OK;
+    }
+
+    size_t value_len = sizeof(gps_stats_t);
+    err = nvs_get_blob(nvs_handle, KEY_GPS_STATS, &stats, &value_len);
+    if (err == ESP_OK && (value_len != sizeof(gps_stats_t) || stats.version != GPS_STATS_VERSION || stats.len != sizeof(gps_stats_t)))
+    { // older layout, statistics are not worth a migration -> start over
+        PRINT_LOG("Discarding GPS stats version %u", stats.version);
+        err = ESP_ERR_INVALID_VERSION;
+    }
+
+    if (err != ESP_OK)
+    {
+        GPS_STATS_reset();
+    }
+    else
+    {
+        update_crc();
+    }
+    return err;
+}
+
+esp_err_t GPS_STATS_save(nvs_handle_t nvs_handle)
+{
+    static gps_stats_t copy;
+
+    GPS_STATS_get(&copy);
+    return nvs_set_blob(nvs_handle, KEY_GPS_STATS, &copy, sizeof(copy)); // commit is done by the caller
+}
+
+void GPS_STATS_first_fix(uint32_t ttff_ms)
+{
+    uint32_t ttff_s = (ttff_ms + 500) / 1000;
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.ttff_s[stats.ttff_head] = (ttff_s > UINT16_MAX) ? UINT16_MAX : ttff_s;
+    stats.ttff_head = (stats.ttff_head + 1) % GPS_STATS_TTFF_HISTORY;
+    if (stats.ttff_cnt < GPS_STATS_TTFF_HISTORY)
+    {
+        stats.ttff_cnt++;
+    }
+    update_crc();
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void GPS_STATS_lock_changed(bool now_locked)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&stats_mux);
+    if (now_locked && !locked)
+    {
+        locked_since_us = now_us;
+        if (outage_start_us != 0)
+        {
+            uint32_t outage_s = (now_us - outage_start_us) / 1000000;
+            uint8_t bucket = 0;
+            while (bucket < ARRAY_LEN(outage_limits_s) && outage_s >= outage_limits_s[bucket])
+            {
+                bucket++;
+            }
+            stats.outages[bucket]++;
+            outage_start_us = 0;
+        }
+    }
+    else if (!now_locked && locked)
+    {
+        account_locked_time(now_us);
+        stats.lock_losses++;
+        outage_start_us = now_us;
+    }
+    locked = now_locked;
+    update_crc();
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void GPS_STATS_get(gps_stats_t* copy)
+{
+    portENTER_CRITICAL(&stats_mux);
+    account_locked_time(esp_timer_get_time());
+    *copy = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+esp_err_t GPS_STATS_set(const gps_stats_t* restored)
+{
+    if (restored->version != GPS_STATS_VERSION || restored->len != sizeof(gps_stats_t))
+        return ESP_ERR_INVALID_VERSION;
+
+    portENTER_CRITICAL(&stats_mux);
+    stats = *restored;
+    update_crc();
+    portEXIT_CRITICAL(&stats_mux);
+    return ESP_OK;
+}
+
+uint32_t GPS_STATS_get_last_ttff_s(void)
+{
+    if (stats.ttff_cnt == 0)
+        return 0;
+    return stats.ttff_s[(stats.ttff_head + GPS_STATS_TTFF_HISTORY - 1) % GPS_STATS_TTFF_HISTORY];
+}
+
+uint32_t GPS_STATS_get_lock_losses(void)
+{
+    return stats.lock_losses;
+}
+
+uint32_t GPS_STATS_get_locked_s(void)
+{
+    portENTER_CRITICAL(&stats_mux);
+    account_locked_time(esp_timer_get_time());
+    uint32_t locked_s = stats.locked_s;
+    portEXIT_CRITICAL(&stats_mux);
+    return locked_s;
+}
+
+void GPS_STATS_print(void)
+{
+    static gps_stats_t copy;
+    char ttff_buf[GPS_STATS_TTFF_HISTORY * 7 + 1]; // up to 5 digits + "s " each
+    char outage_buf[NUM_GPS_OUTAGE * 18 + 1];      // e.g. "<10min:4294967295 "
+    int pos = 0;
+
+    GPS_STATS_get(&copy);
+
+    ttff_buf[0] = 0;
+    for (uint8_t idx = 0; idx < copy.ttff_cnt; idx++) // oldest first
+    {
+        uint8_t ring_idx = (copy.ttff_head + GPS_STATS_TTFF_HISTORY - copy.ttff_cnt + idx) % GPS_STATS_TTFF_HISTORY;
+        pos += snprintf(ttff_buf + pos, sizeof(ttff_buf) - pos, "%us ", copy.ttff_s[ring_idx]);
+    }
+
+    pos = 0;
+    outage_buf[0] = 0;
+    for (uint8_t bucket = 0; bucket < NUM_GPS_OUTAGE; bucket++)
+    {
+        pos += snprintf(outage_buf + pos, sizeof(outage_buf) - pos, "%s:%lu ", outage_names[bucket], copy.outages[bucket]);
+    }
+
+    PRINT_LOG(
+        "GPS:\n"
+        "\tTTFF: %s\n"
+        "\tLock losses: %lu, locked: %lus\n"
+        "\tOutages: %s",
+        ttff_buf, copy.lock_losses, copy.locked_s, outage_buf);
+}
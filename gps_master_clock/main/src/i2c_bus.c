@@ -0,0 +1,308 @@
+#include "i2c_bus.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/i2c_master.h"
+
+#include "custom_main.h"
+#include "bsp.h"
+#include "dfs.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+// Timeout of a transaction once it is on the bus: the address and data bytes take 9 clocks each, doubled
+// for clock stretching and driver overhead, plus MAX_WAIT_TICKS for the bus setup. A full LCD row (84
+// bytes) alone takes ~7.6ms at 100kHz, a fixed MAX_WAIT_TICKS would be too tight for it.
+#define TRANSFER_TIMEOUT_MS(bytes) (MAX_WAIT_TICKS + ((bytes) * 9 * 2 * 1000 + I2C_FREQ_HZ - 1) / I2C_FREQ_HZ)
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+struct i2c_bus_dev
+{
+    i2c_master_dev_handle_t handle;
+    i2c_bus_prio_t prio;
+    const char* name;
+
+    // the one transaction which can be in flight
+    const uint8_t* tx;
+    size_t tx_len;
+    uint8_t* rx;
+    size_t rx_len;
+    int64_t submit_us;
+    esp_err_t result;
+    SemaphoreHandle_t idle; // taken while a transaction is pending
+    StaticSemaphore_t idle_buffer;
+    i2c_bus_done_cb_t done_cb;
+    void* done_arg;
+
+    // stats
+    uint64_t busy_us;      // time the bus was occupied by this device
+    uint32_t max_wait_us;  // longest time from submit until the transaction started
+    uint32_t bytes;
+    uint32_t transactions;
+    uint32_t errors;
+};
+
+//---------------------------------------------------------------------------
+// Local constants
+//---------------------------------------------------------------------------
+
+static const i2c_master_bus_config_t bus_conf =
+{
+    .clk_source = I2C_CLK_SRC_DEFAULT,
+    .i2c_port = I2C_PORT_NUM,
+    .scl_io_num = I2C_SCL_IO,
+    .sda_io_num = I2C_SDA_IO,
+    .glitch_ignore_cnt = 7,
+    .flags.enable_internal_pullup = true,
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static i2c_master_bus_handle_t bus_handle;
+
+static struct i2c_bus_dev devices[I2C_BUS_MAX_DEVICES];
+static uint8_t num_devices;
+static SemaphoreHandle_t add_mutex; // devices get added from different tasks
+static StaticSemaphore_t add_mutex_buffer;
+
+// pending transactions per priority, one device can only be queued once -> length of device pool
+static QueueHandle_t pending_queues[NUM_I2C_BUS_PRIO];
+static StaticQueue_t pending_queue_buffers[NUM_I2C_BUS_PRIO];
+static uint8_t pending_storage[NUM_I2C_BUS_PRIO][I2C_BUS_MAX_DEVICES * sizeof(i2c_bus_dev_handle_t)];
+static SemaphoreHandle_t pending_cnt; // sum over all queues, to block on
+static StaticSemaphore_t pending_cnt_buffer;
+
+static int64_t stats_start_us;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static void execute(i2c_bus_dev_handle_t dev)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    if (dev->rx_len > 0)
+    { // address byte for each direction
+        dev->result = i2c_master_transmit_receive(dev->handle, dev->tx, dev->tx_len, dev->rx, dev->rx_len,
+            TRANSFER_TIMEOUT_MS(dev->tx_len + dev->rx_len + 2));
+    }
+    else
+    {
+        dev->result = i2c_master_transmit(dev->handle, dev->tx, dev->tx_len, TRANSFER_TIMEOUT_MS(dev->tx_len + 1));
+    }
+
+    int64_t end_us = esp_timer_get_time();
+    uint32_t wait_us = start_us - dev->submit_us;
+
+    portENTER_CRITICAL(&stats_mux);
+    dev->busy_us += end_us - start_us;
+    dev->bytes += dev->tx_len + dev->rx_len;
+    dev->transactions++;
+    if (dev->result != ESP_OK)
+    {
+        dev->errors++;
+    }
+    if (wait_us > dev->max_wait_us)
+    {
+        dev->max_wait_us = wait_us;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+
+    if (dev->done_cb != NULL)
+    {
+        dev->done_cb(dev->done_arg, dev->result, end_us);
+    }
+    xSemaphoreGive(dev->idle); // allow the next transaction of this device
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+esp_err_t I2C_BUS_init(void)
+{
+    esp_err_t ret = i2c_new_master_bus(&bus_conf, &bus_handle);
+    if (ret != ESP_OK)
+    {
+        PRINT_LOG("Unable add new master: %d", ret);
+        return ret;
+    }
+
+    for (uint8_t prio = 0; prio < NUM_I2C_BUS_PRIO; prio++)
+    {
+        pending_queues[prio] = xQueueCreateStatic(I2C_BUS_MAX_DEVICES, sizeof(i2c_bus_dev_handle_t),
+            pending_storage[prio], &pending_queue_buffers[prio]);
+    }
+    pending_cnt = xSemaphoreCreateCountingStatic(I2C_BUS_MAX_DEVICES, 0, &pending_cnt_buffer);
+    add_mutex = xSemaphoreCreateMutexStatic(&add_mutex_buffer);
+    stats_start_us = esp_timer_get_time();
+
+    return ESP_OK;
+}
+
+esp_err_t I2C_BUS_add_device(uint8_t addr, i2c_bus_prio_t prio, const char* name, i2c_bus_dev_handle_t* dev)
+{
+    if (bus_handle == NULL || prio >= NUM_I2C_BUS_PRIO)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(add_mutex, portMAX_DELAY);
+    if (num_devices >= I2C_BUS_MAX_DEVICES)
+    {
+        xSemaphoreGive(add_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    const i2c_device_config_t dev_conf =
+    {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = I2C_FREQ_HZ
+    };
+
+    i2c_bus_dev_handle_t new_dev = &devices[num_devices];
+    esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_conf, &new_dev->handle);
+    if (ret != ESP_OK)
+    {
+        PRINT_LOG("Unable to add new device %s: %d", name, ret);
+        xSemaphoreGive(add_mutex);
+        return ret;
+    }
+
+    new_dev->prio = prio;
+    new_dev->name = name;
+    new_dev->idle = xSemaphoreCreateBinaryStatic(&new_dev->idle_buffer);
+    xSemaphoreGive(new_dev->idle); // nothing pending yet
+
+    num_devices++;
+    xSemaphoreGive(add_mutex);
+    *dev = new_dev;
+    return ESP_OK;
+}
+
+esp_err_t I2C_BUS_probe(uint8_t addr)
+{
+    // only used during setup, the driver itself serializes this with ongoing transactions
+    return i2c_master_probe(bus_handle, addr, MAX_WAIT_TICKS);
+}
+
+void I2C_BUS_set_done_cb(i2c_bus_dev_handle_t dev, i2c_bus_done_cb_t cb, void* arg)
+{
+    dev->done_arg = arg;
+    dev->done_cb = cb;
+}
+
+esp_err_t I2C_BUS_submit(i2c_bus_dev_handle_t dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len)
+{
+    // wait for the previous transaction of this device, the caller might reuse its buffers afterwards
+    if (xSemaphoreTake(dev->idle, pdMS_TO_TICKS(I2C_BUS_MAX_TRANSACTION_MS)) != pdTRUE)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    dev->tx = tx;
+    dev->tx_len = tx_len;
+    dev->rx = rx;
+    dev->rx_len = rx_len;
+    dev->submit_us = esp_timer_get_time();
+
+    xQueueSend(pending_queues[dev->prio], &dev, 0); // can not fail, one entry per device
+    xSemaphoreGive(pending_cnt);
+    return ESP_OK;
+}
+
+esp_err_t I2C_BUS_wait(i2c_bus_dev_handle_t dev, uint32_t timeout_ms)
+{
+    if (xSemaphoreTake(dev->idle, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t result = dev->result;
+    xSemaphoreGive(dev->idle); // only wanted to know that it's done
+    return result;
+}
+
+esp_err_t I2C_BUS_transfer(i2c_bus_dev_handle_t dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len, uint32_t timeout_ms)
+{
+    esp_err_t err = I2C_BUS_submit(dev, tx, tx_len, rx, rx_len);
+    if (err == ESP_OK)
+    {
+        err = I2C_BUS_wait(dev, timeout_ms);
+    }
+    return err;
+}
+
+void I2C_BUS_print_stats(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint64_t elapsed_us = now_us - stats_start_us;
+    if (elapsed_us == 0)
+        return;
+
+    for (uint8_t idx = 0; idx < num_devices; idx++)
+    {
+        i2c_bus_dev_handle_t dev = &devices[idx];
+
+        portENTER_CRITICAL(&stats_mux);
+        uint64_t busy_us = dev->busy_us;
+        uint64_t bytes = dev->bytes;
+        uint32_t transactions = dev->transactions;
+        uint32_t max_wait_us = dev->max_wait_us;
+
+        // start a new measurement window
+        dev->busy_us = 0;
+        dev->bytes = 0;
+        dev->transactions = 0;
+        dev->max_wait_us = 0;
+        portEXIT_CRITICAL(&stats_mux);
+
+        PRINT_LOG("I2C %s: util %llu.%02llu%% %luB/s, %lu transactions, %lu errors total, max wait %luus",
+            dev->name,
+            busy_us * 100 / elapsed_us, (busy_us * 10000 / elapsed_us) % 100,
+            (uint32_t)(bytes * 1000000ULL / elapsed_us),
+            transactions, dev->errors, max_wait_us);
+    }
+    stats_start_us = now_us;
+}
+
+bool I2C_BUS_process(uint32_t timeout_ms)
+{
+    TickType_t timeout = (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    if (xSemaphoreTake(pending_cnt, timeout) != pdTRUE)
+    {
+        return false;
+    }
+
+    // serve the highest priority first
+    for (int prio = NUM_I2C_BUS_PRIO - 1; prio >= 0; prio--)
+    {
+        i2c_bus_dev_handle_t dev;
+        if (xQueueReceive(pending_queues[prio], &dev, 0) == pdTRUE)
+        {
+            DFS_acquire(DFS_LOCK_I2C);
+            execute(dev);
+            DFS_release(DFS_LOCK_I2C);
+            break;
+        }
+    }
+    return true;
+}
+
+void I2C_BUS_Task(void *parameter)
+{
+    while(1)
+    {
+        I2C_BUS_process(UINT32_MAX);
+    }
+}
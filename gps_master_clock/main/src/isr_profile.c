@@ -0,0 +1,74 @@
+#include "isr_profile.h"
+
+#if ISR_PROFILE_ENABLE
+
+#include "freertos/FreeRTOS.h"
+#include "esp_rom_sys.h"  // for CPU ticks per us
+
+#include "custom_main.h"
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint32_t count;
+    uint32_t max_ns;
+    uint64_t sum_ns;
+} isr_profile_t;
+
+//---------------------------------------------------------------------------
+// Local constants
+//---------------------------------------------------------------------------
+
+static const char* isr_names[] =
+{
+    [ISR_PROFILE_PWR_GOOD]  = "power good",
+    [ISR_PROFILE_BTN]       = "button",
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static portMUX_TYPE isr_profile_mux = portMUX_INITIALIZER_UNLOCKED;
+static DRAM_ATTR isr_profile_t profiles[NUM_ISR_PROFILE];
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+// the CPU frequency might change with DFS, so the cycles are converted right away
+void IRAM_ATTR ISR_PROFILE_record(isr_profile_id_t id, uint32_t cycles)
+{
+    uint32_t ns = (uint64_t)cycles * 1000 / esp_rom_get_cpu_ticks_per_us();
+
+    portENTER_CRITICAL_SAFE(&isr_profile_mux);
+    isr_profile_t* profile = &profiles[id];
+    profile->count++;
+    profile->sum_ns += ns;
+    if (ns > profile->max_ns)
+    {
+        profile->max_ns = ns;
+    }
+    portEXIT_CRITICAL_SAFE(&isr_profile_mux);
+}
+
+void ISR_PROFILE_print_stats(void)
+{
+    for (uint8_t id = 0; id < NUM_ISR_PROFILE; id++)
+    {
+        isr_profile_t profile;
+        portENTER_CRITICAL(&isr_profile_mux);
+        profile = profiles[id];
+        portEXIT_CRITICAL(&isr_profile_mux);
+
+        if (profile.count == 0)
+            continue;
+
+        PRINT_LOG("ISR %s: n=%lu avg=%lluns max=%luns",
+            isr_names[id], profile.count, profile.sum_ns / profile.count, profile.max_ns);
+    }
+}
+
+#endif // ISR_PROFILE_ENABLE
@@ -0,0 +1,243 @@
+#include "journal.h"
+
+#include <string.h>
+#include <stddef.h> // for offsetof
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "custom_main.h"
+
+/* Layout: the partition is used as a ring of 4kB sectors. Each sector starts with a header (magic and
+ * a sequence number, the highest one is the active sector), followed by 4 byte entries which are
+ * programmed into the erased (0xFF) flash one after another. When the active sector is full, the next
+ * sector gets erased and starts with the current position, so older sectors never need to be read again.
+ * A torn write leaves an entry with a bad CRC, which is skipped.
+ *
+ * Wear: (4096 - 16) / 4 = 1020 entries per sector. Worst case one pulse per minute (1440 per day, the
+ * catch-up after outages is bounded by 720 per outage) fills ~1.4 sectors per day. With the 16 sectors
+ * of the 64kB partition every sector is erased every ~11 days, at 100k erase cycles that is >3000 years. */
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define SECTOR_SIZE         4096
+#define HEADER_SIZE         16 // entries start here
+#define ENTRY_SIZE          4
+#define JOURNAL_MAGIC       0x4C4E524A // "JRNL"
+#define ENTRY_ERASED        0xFFFFFFFF
+
+#define SCAN_CHUNK_ENTRIES  64
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+typedef enum
+{
+    ENTRY_TYPE_POSITION = 1, // absolute hand position, the last one wins
+} entry_type_t;
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t seq_inv; // ~seq, to detect a torn header
+} journal_header_t;
+
+typedef struct
+{
+    uint16_t value;
+    uint8_t type;
+    uint8_t crc; // over value and type
+} journal_entry_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static const esp_partition_t* partition;
+static uint32_t num_sectors;
+static int32_t active_sector = -1; // -1: no sector in use yet
+static uint32_t active_seq;
+static uint32_t write_offset; // within the active sector
+static int last_position = -1;
+
+static SemaphoreHandle_t journal_mutex;
+static StaticSemaphore_t journal_mutex_buffer;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static uint8_t entry_crc(const journal_entry_t* entry)
+{
+    return esp_rom_crc8_le(0, (const uint8_t*)entry, offsetof(journal_entry_t, crc));
+}
+
+static bool read_header(uint32_t sector, uint32_t* seq)
+{
+    journal_header_t header;
+    if (esp_partition_read(partition, sector * SECTOR_SIZE, &header, sizeof(header)) != ESP_OK)
+        return false;
+    if (header.magic != JOURNAL_MAGIC || header.seq != ~header.seq_inv)
+        return false;
+    *seq = header.seq;
+    return true;
+}
+
+// finds the end of the written entries and the last valid position in a sector
+static void scan_sector(uint32_t sector, uint32_t* end_offset, int* position)
+{
+    static uint32_t words[SCAN_CHUNK_ENTRIES];
+
+    *end_offset = SECTOR_SIZE;
+    for (uint32_t offset = HEADER_SIZE; offset < SECTOR_SIZE; offset += sizeof(words))
+    {
+        uint32_t len = (SECTOR_SIZE - offset < sizeof(words)) ? SECTOR_SIZE - offset : sizeof(words);
+        if (esp_partition_read(partition, sector * SECTOR_SIZE + offset, words, len) != ESP_OK)
+            return;
+
+        for (uint32_t idx = 0; idx < len / ENTRY_SIZE; idx++)
+        {
+            if (words[idx] == ENTRY_ERASED)
+            {
+                *end_offset = offset + idx * ENTRY_SIZE;
+                return;
+            }
+
+            journal_entry_t entry;
+            memcpy(&entry, &words[idx], sizeof(entry));
+            if (entry.crc == entry_crc(&entry) && entry.type == ENTRY_TYPE_POSITION && entry.value < MINUTES_PER_12H)
+            {
+                *position = entry.value;
+            }
+        }
+    }
+}
+
+static esp_err_t write_entry(int minutes_12o_clock)
+{
+    journal_entry_t entry = { .value = minutes_12o_clock, .type = ENTRY_TYPE_POSITION };
+    entry.crc = entry_crc(&entry);
+
+    esp_err_t err = esp_partition_write(partition, active_sector * SECTOR_SIZE + write_offset, &entry, sizeof(entry));
+    write_offset += ENTRY_SIZE; // also on error, the word might be partially programmed
+    return err;
+}
+
+// start the next sector, it begins with the current state so the older sectors become obsolete
+static esp_err_t rotate(void)
+{
+    uint32_t sector = (active_sector < 0) ? 0 : (active_sector + 1) % num_sectors;
+    journal_header_t header = { .magic = JOURNAL_MAGIC, .seq = active_seq + 1, .seq_inv = ~(active_seq + 1) };
+
+    esp_err_t err = esp_partition_erase_range(partition, sector * SECTOR_SIZE, SECTOR_SIZE);
+    if (err == ESP_OK)
+    {
+        err = esp_partition_write(partition, sector * SECTOR_SIZE, &header, sizeof(header));
+    }
+    if (err != ESP_OK)
+    {
+        PRINT_LOG("Unable to start journal sector %lu: %d", sector, err);
+        return err;
+    }
+
+    active_sector = sector;
+    active_seq = header.seq;
+    write_offset = HEADER_SIZE;
+    return ESP_OK;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+esp_err_t JOURNAL_init(int* minutes_12o_clock)
+{
+    journal_mutex = xSemaphoreCreateMutexStatic(&journal_mutex_buffer);
+
+    // everything comes from the flash, nothing from a previous init
+    active_sector = -1;
+    active_seq = 0;
+    write_offset = 0;
+    last_position = -1;
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, JOURNAL_PARTITION_LABEL);
+    if (partition == NULL)
+    {
+        PRINT_LOG("No journal partition");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    num_sectors = partition->size / SECTOR_SIZE;
+
+    // the active sector has the highest sequence number
+    for (uint32_t sector = 0; sector < num_sectors; sector++)
+    {
+        uint32_t seq;
+        if (read_header(sector, &seq) && (active_sector < 0 || seq > active_seq))
+        {
+            active_sector = sector;
+            active_seq = seq;
+        }
+    }
+
+    if (active_sector < 0)
+    {
+        return ESP_ERR_NOT_FOUND; // empty journal, first write starts it
+    }
+
+    scan_sector(active_sector, &write_offset, &last_position);
+    if (last_position < 0)
+    { // rotation was interrupted before the first entry, the previous sector still has the position
+        for (uint32_t sector = 0; sector < num_sectors; sector++)
+        {
+            uint32_t seq, unused;
+            if (read_header(sector, &seq) && seq == active_seq - 1)
+            {
+                scan_sector(sector, &unused, &last_position);
+                break;
+            }
+        }
+    }
+
+    PRINT_LOG("Journal sector %ld seq %lu, offset %lu", active_sector, active_seq, write_offset);
+    if (last_position < 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *minutes_12o_clock = last_position;
+    return ESP_OK;
+}
+
+esp_err_t JOURNAL_record_position(int minutes_12o_clock)
+{
+    esp_err_t err = ESP_OK;
+
+    if (partition == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    if (minutes_12o_clock != last_position)
+    {
+        if (active_sector < 0 || write_offset + ENTRY_SIZE > SECTOR_SIZE)
+        {
+            err = rotate();
+        }
+        if (err == ESP_OK)
+        {
+            err = write_entry(minutes_12o_clock);
+        }
+        if (err == ESP_OK)
+        {
+            last_position = minutes_12o_clock;
+        }
+    }
+    xSemaphoreGive(journal_mutex);
+    return err;
+}
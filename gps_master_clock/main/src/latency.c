@@ -0,0 +1,114 @@
+#include "latency.h"
+
+#include "freertos/FreeRTOS.h"
+
+#include "custom_main.h"
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint32_t buckets[LATENCY_NUM_BUCKETS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} latency_hist_t;
+
+//---------------------------------------------------------------------------
+// Local constants
+//---------------------------------------------------------------------------
+
+static const char* stage_names[] =
+{
+    [LATENCY_STAGE_TIMEKEEP_RX] = "timekeep rx",
+    [LATENCY_STAGE_LOCALTIME]   = "localtime",
+    [LATENCY_STAGE_PULSE_EDGE]  = "pulse edge",
+    [LATENCY_STAGE_LCD_RX]      = "lcd rx",
+    [LATENCY_STAGE_LCD_WRITE]   = "lcd write",
+    [LATENCY_STAGE_GPS_PARSE]   = "gps parse",
+    [LATENCY_STAGE_TICK_PERIOD] = "tick period",
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static portMUX_TYPE latency_mux = portMUX_INITIALIZER_UNLOCKED;
+static DRAM_ATTR latency_hist_t hists[NUM_LATENCY_STAGES];
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void IRAM_ATTR LATENCY_record(latency_stage_t stage, int64_t tick_us)
+{
+    if (tick_us <= 0) // message did not originate from a tick
+        return;
+
+    int64_t delta = esp_timer_get_time() - tick_us;
+    LATENCY_record_us(stage, (delta < 0) ? 0 : (delta > UINT32_MAX) ? UINT32_MAX : (uint32_t)delta);
+}
+
+void IRAM_ATTR LATENCY_record_us(latency_stage_t stage, uint32_t latency_us)
+{
+    if (stage >= NUM_LATENCY_STAGES)
+        return;
+
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_NUM_BUCKETS - 1 && (latency_us >> bucket) != 0)
+    {
+        bucket++;
+    }
+
+    portENTER_CRITICAL_SAFE(&latency_mux);
+    latency_hist_t* hist = &hists[stage];
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum_us += latency_us;
+    if (latency_us > hist->max_us)
+    {
+        hist->max_us = latency_us;
+    }
+    if (hist->count == 1 || latency_us < hist->min_us)
+    {
+        hist->min_us = latency_us;
+    }
+    portEXIT_CRITICAL_SAFE(&latency_mux);
+}
+
+void LATENCY_print_stats(void)
+{
+    char bucket_str[LATENCY_NUM_BUCKETS * 14 + 1];
+
+    for (uint8_t stage = 0; stage < NUM_LATENCY_STAGES; stage++)
+    {
+        latency_hist_t hist;
+        portENTER_CRITICAL(&latency_mux);
+        hist = hists[stage]; // work on a copy, the tasks keep on recording
+        portEXIT_CRITICAL(&latency_mux);
+
+        if (hist.count == 0)
+            continue;
+
+        // only print the populated buckets as "<upper bound in us>:count", the last one as ">=lower bound:count"
+        int len = 0;
+        bucket_str[0] = 0;
+        for (uint8_t bucket = 0; bucket < LATENCY_NUM_BUCKETS; bucket++)
+        {
+            if (hist.buckets[bucket] == 0 || len >= sizeof(bucket_str))
+                continue;
+            if (bucket == LATENCY_NUM_BUCKETS - 1)
+                len += snprintf(bucket_str + len, sizeof(bucket_str) - len, " >=%lu:%lu",
+                    1UL << (bucket - 1), hist.buckets[bucket]);
+            else
+                len += snprintf(bucket_str + len, sizeof(bucket_str) - len, " <%lu:%lu",
+                    1UL << bucket, hist.buckets[bucket]);
+        }
+
+        PRINT_LOG("Latency %s: n=%lu avg=%lluus min=%luus max=%luus jitter=%luus\n\t%s",
+            stage_names[stage], hist.count, hist.sum_us / hist.count, hist.min_us, hist.max_us,
+            hist.max_us - hist.min_us, bucket_str);
+    }
+}
@@ -6,9 +6,10 @@
 // peripherals
 #include "driver/gpio.h"
 #include "driver/uart.h"
+#include "hal/gpio_ll.h"    // IRAM safe pin access for the ISR
+#include "soc/gpio_struct.h"
 #include "bsp.h"
 #include "esp_system.h" // misc, for reset reason
-#include "esp_pm.h"
 
 // for OS methods
 #include "freertos/FreeRTOS.h"
@@ -19,9 +20,22 @@
 #include "neo6m.h"
 #include "timekeep.h"
 #include "LCD.h"
-
-#define MIN_PWR_BAD_CNT     100     // number of times power bad has to be observed for shutdown
-#define MIN_PWR_GOOD_CNT    10000   // number of subsequent power good observations to normally resume
+#include "i2c_bus.h"
+#include "gps_stats.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "mirror.h"
+#include "deepsleep.h"
+#include "dfs.h"
+#include "isr_profile.h"
+#include "stats.h"
+
+#define PWR_BAD_DEBOUNCE_US 10000     // power bad has to be stable this long for shutdown
+#define PWR_GOOD_HOLD_US    10000000  // power good has to be stable this long to normally resume
+
+// notification bits for PWR_Task
+#define PWR_EVT_BAD         0x01 // power bad for PWR_BAD_DEBOUNCE_US
+#define PWR_EVT_GOOD        0x02 // power good for PWR_GOOD_HOLD_US
 
 #define SETUP_TASK_VARS(taskname, stacksize, queueElemByteCnt) \
     static StackType_t taskStack##taskname[stacksize];         \
@@ -44,14 +58,15 @@
         &queue##taskname)
 
 #define CREATE_TASK_STATIC(taskname)                         \
-    xTaskCreateStatic(                                       \
+    xTaskCreateStaticPinnedToCore(                           \
             taskname##_Task,                                 \
             #taskname,                                       \
             STACKSIZE_##taskname,                            \
             NULL,                                            \
             TASK_PRIO_##taskname,                            \
             taskStack##taskname,                             \
-            &taskBuffer##taskname                            \
+            &taskBuffer##taskname,                           \
+            TASK_CORE_##taskname                             \
     )
 
 /* Messaging */
@@ -65,14 +80,55 @@
 #define STACKSIZE_TIMEKEEP  2028
 #define STACKSIZE_LCD       4096
 #define STACKSIZE_PWR       2028
+#define STACKSIZE_I2C_BUS   2048
+#define STACKSIZE_STATS     4096
+
+/* Core placement presets. The esp_timer task (second tick) and the logging UART interrupt run on the PRO
+ * core. The LCD only renders into its frame buffer, the I2C_BUS task does the transfers and blocks while the
+ * bus is busy. Compare the tick/pulse jitter and gps parse latency in the stats, see README.md. */
+#define PLACEMENT_NO_AFFINITY   0 // the scheduler picks
+#define PLACEMENT_TIMING_APP    1 // NEO6M/TIMEKEEP/PWR alone on the APP core, LCD/I2C and logging on the PRO core
+#define PLACEMENT_TIMING_PRO    2 // NEO6M/TIMEKEEP/PWR next to the esp_timer task, LCD/I2C on the APP core
+
+#define TASK_PLACEMENT PLACEMENT_TIMING_APP
+
+#if TASK_PLACEMENT == PLACEMENT_TIMING_APP
+#define CORE_TIMING         APP_CPU_NUM
+#define CORE_OTHER          PRO_CPU_NUM
+#elif TASK_PLACEMENT == PLACEMENT_TIMING_PRO
+#define CORE_TIMING         PRO_CPU_NUM
+#define CORE_OTHER          APP_CPU_NUM
+#else
+#define CORE_TIMING         tskNO_AFFINITY
+#define CORE_OTHER          tskNO_AFFINITY
+#endif
+
+#define TASK_CORE_NEO6M     CORE_TIMING
+#define TASK_CORE_TIMEKEEP  CORE_TIMING
+#define TASK_CORE_PWR       CORE_TIMING
+#define TASK_CORE_LCD       CORE_OTHER
+#define TASK_CORE_I2C_BUS   CORE_OTHER // executes the LCD transfers
+#define TASK_CORE_STATS     CORE_OTHER // long log dumps
+
+// every task needs a valid placement, and the timing critical ones must not share a core with the LCD
+#define TASK_LIST(X) X(LCD) X(TIMEKEEP) X(NEO6M) X(PWR) X(I2C_BUS) X(STATS)
+#define CHECK_TASK_CORE(taskname) \
+    _Static_assert(TASK_CORE_##taskname == tskNO_AFFINITY || TASK_CORE_##taskname < portNUM_PROCESSORS, \
+        "invalid core for task " #taskname);
+TASK_LIST(CHECK_TASK_CORE)
+_Static_assert(TASK_PLACEMENT == PLACEMENT_NO_AFFINITY ||
+    (TASK_CORE_NEO6M != TASK_CORE_LCD && TASK_CORE_TIMEKEEP != TASK_CORE_LCD && TASK_CORE_PWR != TASK_CORE_LCD),
+    "timing critical task placed on the LCD core");
 
 /* TASK */
 enum
 {
     // priorities (higher number = higher prio)
+    TASK_PRIO_STATS = tskIDLE_PRIORITY, // only when nothing else has to run
     TASK_PRIO_LCD = 1,
     TASK_PRIO_TIMEKEEP,
     TASK_PRIO_NEO6M,
+    TASK_PRIO_I2C_BUS, // above all bus clients, transactions are short
     TASK_PRIO_PWR,
 };
 
@@ -81,14 +137,38 @@ SETUP_TASK_VARS(LCD, STACKSIZE_LCD, QUEUE_STORAGE_GENERAL)
 SETUP_TASK_VARS(TIMEKEEP, STACKSIZE_TIMEKEEP, QUEUE_STORAGE_GENERAL)
 SETUP_TASK_VARS_NO_QUEUE(NEO6M, STACKSIZE_NEO6M)
 SETUP_TASK_VARS_NO_QUEUE(PWR, STACKSIZE_PWR)
+SETUP_TASK_VARS_NO_QUEUE(I2C_BUS, STACKSIZE_I2C_BUS)
+SETUP_TASK_VARS_NO_QUEUE(STATS, STACKSIZE_STATS)
 
-// for fast and uncomplicated assignment of task ID<->queue
-static const QueueHandle_t *handleLookup[] =
+// for fast and uncomplicated assignment of task ID<->queue, in DRAM since it is used from ISRs
+static const DRAM_ATTR QueueHandle_t *handleLookup[] =
 {
         [TASK_LCD]      = &queueHandleLCD,
         [TASK_TIMEKEEP] = &queueHandleTIMEKEEP,
 };
 
+// tasks which wait on their notification, they get TASK_NOTIFY_MSG with every queued message
+static TaskHandle_t* const DRAM_ATTR notifyLookup[] =
+{
+#if SECOND_TICK_ISR
+        [TASK_TIMEKEEP] = &taskHandleTIMEKEEP,
+#endif // SECOND_TICK_ISR
+        [TASK_LCD]      = NULL,
+};
+
+static TaskHandle_t IRAM_ATTR notify_handle(task_type_t dst)
+{
+    if (dst >= sizeof(notifyLookup) / sizeof(notifyLookup[0]) || notifyLookup[dst] == NULL)
+        return NULL;
+    return *(notifyLookup[dst]);
+}
+
+static volatile int64_t power_bad_edge_us; // first power bad edge of the episode, to measure the save latency
+
+// one shot timer for the debounce/hysteresis windows, restarted with every edge of power good
+static esp_timer_handle_t pwr_timer;
+static volatile int pwr_armed_level; // level the window was started for
+
 // for logging
 SemaphoreHandle_t xUartSemaphore;
 char print_buf[MAX_LOG_LEN];
@@ -112,8 +192,9 @@ static const uart_config_t uart_config = {
 };
 
 // Place the ram mirror into RTC RAM. In case of a SW failure we could be able to
-// retrieve the last saved values and store them in NVS.
-RTC_DATA_ATTR ram_mirror_t rm;
+// retrieve the last saved values and store them in NVS. Not initialized by the bootloader
+// (unlike RTC_DATA_ATTR), the checkpoint header in mirror.c tells if it is still valid.
+RTC_NOINIT_ATTR ram_mirror_t rm;
 
 static void init_serial_print(void)
 {
@@ -134,8 +215,7 @@ static void init_serial_print(void)
 #if SET_NVS_DEFAULTS == 0
 static esp_err_t load_nvs_data(nvs_handle_t nvs_handle)
 {
-    size_t value_len = sizeof(ram_mirror_t);
-    esp_err_t err = nvs_get_blob(nvs_handle, KEY_RAM_MIRROR, (void *)&rm, &value_len);
+    esp_err_t err = MIRROR_load(nvs_handle);
     if (err != ESP_OK)
     {
         PRINT_LOG("Unable to obtain data, error: %d", err);
@@ -146,9 +226,12 @@ static esp_err_t load_nvs_data(nvs_handle_t nvs_handle)
 
 static esp_err_t save_nvs_data(nvs_handle_t nvs_handle)
 {
-    size_t value_len = sizeof(ram_mirror_t);
     rm.mirror_saved_times++;
-    esp_err_t err = nvs_set_blob(nvs_handle, KEY_RAM_MIRROR, (void *)&rm, value_len);
+    esp_err_t err = MIRROR_save(nvs_handle);
+    if (err == ESP_OK)
+    {
+        err = GPS_STATS_save(nvs_handle);
+    }
     if (err == ESP_OK)
     {
         err = nvs_commit(nvs_handle);
@@ -184,6 +267,11 @@ static esp_err_t inital_nvs_load(bool soft_reset)
     
     nvs_handle_t nvs_handle = {0};
 
+    // emergency save from the last power loss, if any
+    static snapshot_t snapshot;
+    bool snapshot_found = false;
+    SNAPSHOT_init(&snapshot, &snapshot_found);
+
     // Open NVS handle
     PRINT_LOG("Opening Non-Volatile Storage (NVS) handle...");
     err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
@@ -192,11 +280,17 @@ static esp_err_t inital_nvs_load(bool soft_reset)
     if (err == ESP_OK)
     {
         bool loaded_from_nvs = false;
+
+        // before the RAM mirror handling, which might already save them
+        if (GPS_STATS_load(nvs_handle, soft_reset) != ESP_OK)
+        {
+            PRINT_LOG("Starting with empty GPS stats");
+        }
     
         // Check if the RAM mirror can be used
         if (soft_reset)
         { // there is hope to load a valid ram mirror
-            if (rm.magic_word == RAM_MIRROR_VALID_MAGIC)
+            if (MIRROR_rtc_valid())
             { // back up the data, in case a future power cycle happens
                 err = save_nvs_data(nvs_handle);
                 PRINT_LOG("Trying to save valid RAM mirror to NVS...");
@@ -227,6 +321,19 @@ static esp_err_t inital_nvs_load(bool soft_reset)
         {
             PRINT_LOG("Nothing to load from");
         }
+
+        // the snapshot is newer if it was written after the last NVS store (RTC RAM is always the newest)
+        if (snapshot_found && snapshot.rm.magic_word == RAM_MIRROR_VALID_MAGIC &&
+            (err != ESP_OK || (loaded_from_nvs && snapshot.rm.mirror_saved_times > rm.mirror_saved_times)))
+        {
+            rm = snapshot.rm;
+            if (GPS_STATS_set(&snapshot.gps_stats) != ESP_OK)
+            {
+                PRINT_LOG("Snapshot GPS stats have an old layout, keeping the loaded ones");
+            }
+            err = save_nvs_data(nvs_handle); // the deferred part of the emergency save
+            PRINT_LOG("Restored snapshot #%lu", snapshot.rm.mirror_saved_times);
+        }
     }
     
     if (err != ESP_OK) // in case any of the operations failed: Try to re-init with defaults
@@ -234,6 +341,7 @@ static esp_err_t inital_nvs_load(bool soft_reset)
     {
         PRINT_LOG("Re-initializing NVS...");
         rm = rm_dflt;
+        GPS_STATS_reset();
         err = save_nvs_data(nvs_handle);
         if (err == ESP_OK)
         {
@@ -244,6 +352,11 @@ static esp_err_t inital_nvs_load(bool soft_reset)
             PRINT_LOG("Unable to set defaults");
         }
     }
+    if (err == ESP_OK)
+    { // the snapshot is in NVS now, have the sector erased for the next power loss
+        SNAPSHOT_clear();
+    }
+
     PRINT_LOG(
         "Using config:\n"
         "\tcurrent_minutes_12o_clock: %d (%02d:%02d)\n"
@@ -351,11 +464,15 @@ bool sendTaskMessage(task_msg_t *msg)
     else
     {
         success = true;
+        if (notify_handle(msg->dst) != NULL)
+        {
+            xTaskNotify(notify_handle(msg->dst), TASK_NOTIFY_MSG, eSetBits);
+        }
     }
     return success;
 }
 
-bool sendTaskMessageISR(task_msg_t *msg)
+bool IRAM_ATTR sendTaskMessageISR(task_msg_t *msg)
 {
     QueueHandle_t handle = NULL;
     BaseType_t xHigherPriorityTaskWoken = pdFALSE; // not woken any task at start of ISR
@@ -365,14 +482,27 @@ bool sendTaskMessageISR(task_msg_t *msg)
         handle = *(handleLookup[msg->dst]); // determine queue handle
     }
 
-    if (handle)
+    if (handle && xQueueSendFromISR(handle, (void *)msg, &xHigherPriorityTaskWoken) == pdTRUE &&
+        notify_handle(msg->dst) != NULL)
     {
-        xQueueSendFromISR(handle, (void *)msg, &xHigherPriorityTaskWoken);
+        xTaskNotifyFromISR(notify_handle(msg->dst), TASK_NOTIFY_MSG, eSetBits, &xHigherPriorityTaskWoken);
     }
 
     return xHigherPriorityTaskWoken;
 }
 
+bool IRAM_ATTR notifyTaskISR(task_type_t dst, uint32_t bits)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    TaskHandle_t handle = notify_handle(dst);
+
+    if (handle)
+    {
+        xTaskNotifyFromISR(handle, bits, eSetBits, &xHigherPriorityTaskWoken);
+    }
+    return xHigherPriorityTaskWoken;
+}
+
 esp_err_t store_ram_mirror(void)
 {
     nvs_handle_t nvs_handle;
@@ -386,124 +516,189 @@ esp_err_t store_ram_mirror(void)
     return err;
 }
 
-static void IRAM_ATTR gpio_interrupt_handler(void *args)
+/* The GPIO interrupt runs at level 3 from IRAM, so flash operations (NVS, journal) do not delay it. Everything
+ * called from here has to be in IRAM as well: the gpio_ll functions are inlined, esp_timer (ESP_TIMER_IN_IRAM)
+ * and the FreeRTOS ISR functions are in IRAM. The ISR service serves lower pin numbers first. */
+_Static_assert(POWER_GOOD_IO < USR_BUTTON_IO, "power good has to be served before the button");
+
+static void IRAM_ATTR power_good_isr(void *args)
 {
-    gpio_num_t pinNumber = *((gpio_num_t*)args);
-    if (pinNumber == USR_BUTTON_IO)
-    {
-        btn_handler(false);
+    ISR_PROFILE_BEGIN();
+    int level = gpio_ll_get_level(&GPIO, POWER_GOOD_IO);
+
+    // (re)start the window for the new level
+    pwr_armed_level = level;
+    esp_timer_stop(pwr_timer);
+    esp_timer_start_once(pwr_timer, level ? PWR_GOOD_HOLD_US : PWR_BAD_DEBOUNCE_US);
+
+    if (level == 0 && power_bad_edge_us == 0)
+    { // falling edge: start of the hold-up time
+        power_bad_edge_us = esp_timer_get_time();
     }
-    else if (pinNumber == POWER_GOOD_IO)
+    ISR_PROFILE_END(ISR_PROFILE_PWR_GOOD);
+}
+
+static void IRAM_ATTR button_isr(void *args)
+{
+    ISR_PROFILE_BEGIN();
+    btn_handler(false);
+    ISR_PROFILE_END(ISR_PROFILE_BTN);
+}
+
+// the level was stable for the whole window
+static void pwr_timer_callback(void* arg)
+{
+    if (gpio_get_level(POWER_GOOD_IO) == pwr_armed_level && taskHandlePWR != NULL)
     {
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xTaskNotifyFromISR( taskHandlePWR, 0, eSetBits, &xHigherPriorityTaskWoken );
-        portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+        xTaskNotify(taskHandlePWR, pwr_armed_level ? PWR_EVT_GOOD : PWR_EVT_BAD, eSetBits);
     }
 }
 
-void handle_power_bad(void)
+static const esp_timer_create_args_t pwr_timer_args =
 {
-    int power_bad_count = 0, power_good_count = 0;
-    while(1)
+    .callback = &pwr_timer_callback,
+    .name = "pwrTimer"
+};
+
+// Persist the final state once the tasks are shut down. The snapshot takes well below 1ms, NVS is only the
+// fallback if no slot is left. The worst case latency since the power bad edge (debounce and shutdown
+// included) is logged to dimension the hold-up capacitor.
+static void emergency_save(void)
+{
+    static int64_t worst_latency_us = 0;
+
+    esp_err_t err = SNAPSHOT_save();
+    int64_t latency_us = esp_timer_get_time() - power_bad_edge_us;
+    if (err != ESP_OK)
     {
-        if (gpio_get_level(POWER_GOOD_IO) == 0) // periodically check the power good pin
-        {
-            power_good_count = 0; // reset good counter immediately
-            if (power_bad_count < MIN_PWR_BAD_CNT)
-            {
-                power_bad_count++;
-                if (power_bad_count == MIN_PWR_BAD_CNT) // only do it once
-                {
-                    PRINT_LOG("Power bad, shutting down tasks");
-                    
-                    // Tasks which are a bit more delicate, let them finish what they are doing right now
-                    task_msg_t msg = {.cmd = TASK_CMD_SHUTDOWN, .dst = TASK_TIMEKEEP };
-                    sendTaskMessage(&msg);
-                    msg.dst = TASK_LCD;
-                    sendTaskMessage(&msg);
-
-                    wait_shutdown();
-                    PRINT_LOG("Shutdown complete, storing..");
-
-                    // it's now OK to save the system state
-                    store_ram_mirror();
-                }
-            }
-        }
-        else if (power_bad_count) // power was bad, we could be recovering
-        {
-            if (power_good_count < MIN_PWR_GOOD_CNT)
-            {
-                power_good_count++;
-                if (power_good_count == MIN_PWR_GOOD_CNT) // only do it once
-                {
-                    PRINT_LOG("Power recovered, resuming tasks");
-
-                    power_bad_count = 0;
-                    power_good_count = 0;
-
-                    // resume all tasks
-                    vTaskResume(taskHandleLCD);
-                    vTaskResume(taskHandleTIMEKEEP);
-                    break;
-                }
-            }
-        } // else: do nothing when no power bad detected
-        vTaskDelay(1); // wait some time
+        PRINT_LOG("Emergency save failed: %s, storing to NVS", esp_err_to_name(err));
+        store_ram_mirror();
+        return;
     }
-}
 
+    if (latency_us > worst_latency_us)
+    {
+        worst_latency_us = latency_us;
+    }
+    PRINT_LOG("Emergency save done %lldus after power bad edge (worst: %lldus)", latency_us, worst_latency_us);
+}
 
 void PWR_Task(void *parameter)
 {
     uint32_t ulNotifiedValue;
+    bool shut_down = false;
+
     while(1)
     {
-
-         xTaskNotifyWait( 0x00,             /* Don't clear any notification bits on entry. */
+        xTaskNotifyWait( 0x00,             /* Don't clear any notification bits on entry. */
                          ULONG_MAX,         /* Reset the notification value to 0 on exit. */
                          &ulNotifiedValue,  /* Notified value pass out in ulNotifiedValue. */
                          portMAX_DELAY      /* Block indefinitely. */
         );
-        handle_power_bad();
+
+        if ((ulNotifiedValue & PWR_EVT_BAD) && !shut_down)
+        {
+            PRINT_LOG("Power bad, shutting down tasks");
+
+            // Tasks which are a bit more delicate, let them finish what they are doing right now
+            task_msg_t msg = {.cmd = TASK_CMD_SHUTDOWN, .dst = TASK_TIMEKEEP };
+            sendTaskMessage(&msg);
+            msg.dst = TASK_LCD;
+            sendTaskMessage(&msg);
+
+            wait_shutdown();
+            PRINT_LOG("Shutdown complete, storing..");
+
+            // it's now OK to save the final system state
+            emergency_save();
+            shut_down = true;
+
+#if DEEP_SLEEP_ON_POWER_FAIL
+            PRINT_LOG("Entering deep sleep");
+            uart_wait_tx_done(LOGGING_UART_PORT, pdMS_TO_TICKS(MAX_LOG_WAIT_MS));
+            DEEPSLEEP_enter(); // continues with a reset once power is good again
+#endif // DEEP_SLEEP_ON_POWER_FAIL
+        }
+
+        if (ulNotifiedValue & PWR_EVT_GOOD)
+        {
+            if (shut_down)
+            {
+                PRINT_LOG("Power recovered, resuming tasks");
+
+                // resume all tasks
+                vTaskResume(taskHandleLCD);
+                vTaskResume(taskHandleTIMEKEEP);
+            }
+            shut_down = false;
+            power_bad_edge_us = 0;
+        }
     }
 }
 
 void app_main(void)
 {
-    static gpio_num_t pwr_good_io = POWER_GOOD_IO;
-    static gpio_num_t usr_btn_io = USR_BUTTON_IO;
     esp_reset_reason_t reason = esp_reset_reason();
+    uint64_t slept_us = 0;
+    uint32_t sleep_polls = 0;
+    bool from_deep_sleep = DEEPSLEEP_woke_up(&slept_us, &sleep_polls);
 
     init_serial_print();
 
-    // Setup power good IO as external interrupt
+    // Setup power good IO as external interrupt, both edges for the hysteresis
+    ESP_ERROR_CHECK(esp_timer_create(&pwr_timer_args, &pwr_timer));
     gpio_set_direction(POWER_GOOD_IO, GPIO_MODE_INPUT);
-    gpio_set_intr_type(POWER_GOOD_IO, GPIO_INTR_NEGEDGE);
+    gpio_set_intr_type(POWER_GOOD_IO, GPIO_INTR_ANYEDGE);
 
     // Setup button IO as external interrupt
     gpio_set_direction(USR_BUTTON_IO, GPIO_MODE_INPUT);
     gpio_set_intr_type(USR_BUTTON_IO, GPIO_INTR_NEGEDGE);
 
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(USR_BUTTON_IO, gpio_interrupt_handler, (void*)&usr_btn_io);
-    gpio_isr_handler_add(POWER_GOOD_IO, gpio_interrupt_handler, (void*)&pwr_good_io);
+    gpio_install_isr_service(ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3); // above the UART and timer interrupts
+    gpio_isr_handler_add(POWER_GOOD_IO, power_good_isr, NULL);
+    gpio_isr_handler_add(USR_BUTTON_IO, button_isr, NULL);
 
-    esp_pm_config_t pm_config = {
-        .light_sleep_enable = true,
-    };
-    esp_pm_configure(&pm_config);
+    esp_err_t err = DFS_init();
+    if (err != ESP_OK)
+    {
+        PRINT_LOG("Error (%s) while setting up power management!", esp_err_to_name(err));
+    }
 
-    PRINT_LOG("\nStarting application. Reset reason: %d\n", reason);
+    PRINT_LOG("\nStarting application. Reset reason: %d, task placement: %d\n", reason, TASK_PLACEMENT);
 
     // If the reset reason is not a power cycle, it's likely due to some SW issue
     bool soft_reset = reason != ESP_RST_UNKNOWN && reason != ESP_RST_POWERON;
-    esp_err_t err= inital_nvs_load(soft_reset);
+    err = inital_nvs_load(soft_reset);
     if (err != ESP_OK)
     {
         PRINT_LOG("Error (%s) while handling NVS!", esp_err_to_name(err));
     }
 
+    // the journal is written with every pulse, so it is more recent than the mirror
+    int journal_minutes;
+    if (JOURNAL_init(&journal_minutes) == ESP_OK && journal_minutes != rm.current_minutes_12o_clock)
+    {
+        PRINT_LOG("Hand position from journal: %02d:%02d (mirror: %02d:%02d)",
+            journal_minutes / 60, journal_minutes % 60,
+            rm.current_minutes_12o_clock / 60, rm.current_minutes_12o_clock % 60);
+        rm.current_minutes_12o_clock = journal_minutes;
+        MIRROR_checkpoint();
+    }
+
+    if (from_deep_sleep)
+    { // the hands stood still, TIMEKEEP catches up as soon as the time is known (anchor, RTC or GPS)
+        uint64_t behind_min = ((slept_us / 1000000 + 59) / 60) % MINUTES_PER_12H; // the dial repeats every 12h
+        PRINT_LOG("Power fail deep sleep for %llus (%lu polls), catching up ~%llu minutes in ~%llus",
+            slept_us / 1000000, sleep_polls, behind_min,
+            behind_min * (rm.pulse_len_ms + rm.pulse_pause_ms) / 1000);
+    }
+
+    err = I2C_BUS_init();
+    if (err != ESP_OK)
+    {
+        PRINT_LOG("Error (%s) while setting up I2C bus!", esp_err_to_name(err));
+    }
+
     SETUP_QUEUE(TIMEKEEP, QUEUE_LEN_GENERAL);
     SETUP_QUEUE(LCD, QUEUE_LEN_GENERAL);
 
@@ -511,4 +706,6 @@ void app_main(void)
     taskHandleTIMEKEEP  = CREATE_TASK_STATIC(TIMEKEEP);
     taskHandleLCD       = CREATE_TASK_STATIC(LCD);
     taskHandlePWR       = CREATE_TASK_STATIC(PWR);
+    taskHandleI2C_BUS   = CREATE_TASK_STATIC(I2C_BUS);
+    taskHandleSTATS     = CREATE_TASK_STATIC(STATS);
 }
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "mirror.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_rom_crc.h"
+
+#include "custom_main.h"
+#include "TinyGPS_wrapper.h" // for invalid altitude
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint16_t version; // RAM_MIRROR_VERSION
+    uint16_t len;     // of the payload
+    uint32_t crc;     // CRC32 of the payload
+} mirror_header_t;
+
+typedef struct
+{
+    mirror_header_t header;
+    ram_mirror_t rm;
+} mirror_stored_t;
+
+// Historic layouts, exactly as they were written to NVS. Never change these.
+typedef struct
+{
+    time_t last_connected_utc;
+    int current_minutes_12o_clock;
+    uint32_t total_pos_time_corrected;
+    uint32_t total_neg_time_corrected;
+    uint32_t total_uptime_seconds;
+    uint32_t mirror_saved_times;
+    uint32_t magic_word;
+    uint16_t pulse_len_ms;
+    uint16_t pulse_pause_ms;
+} ram_mirror_v1_t;
+
+typedef union
+{
+    mirror_stored_t current;
+    ram_mirror_v1_t v1;
+} mirror_blob_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+// header of the RTC RAM copy, survives soft resets like rm itself
+RTC_NOINIT_ATTR static mirror_header_t rtc_header;
+static portMUX_TYPE checkpoint_mux = portMUX_INITIALIZER_UNLOCKED;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// ROM table driven implementation, ~1us for the mirror at 240MHz
+static uint32_t mirror_crc(const ram_mirror_t* mirror)
+{
+    return esp_rom_crc32_le(0, (const uint8_t*)mirror, sizeof(ram_mirror_t));
+}
+
+static void migrate_v1(const ram_mirror_v1_t* v1)
+{
+    rm = (ram_mirror_t){0};
+    rm.last_connected_utc = v1->last_connected_utc;
+    rm.current_minutes_12o_clock = v1->current_minutes_12o_clock;
+    rm.total_pos_time_corrected = v1->total_pos_time_corrected;
+    rm.total_neg_time_corrected = v1->total_neg_time_corrected;
+    rm.total_uptime_seconds = v1->total_uptime_seconds;
+    rm.mirror_saved_times = v1->mirror_saved_times;
+    rm.magic_word = v1->magic_word;
+    rm.pulse_len_ms = v1->pulse_len_ms;
+    rm.pulse_pause_ms = v1->pulse_pause_ms;
+
+    // added in version 2
+    rm.last_alt_cm = TINYGPS_WRAPPER_INVALID_ALTITUDE;
+    rm.last_pos_valid = 0;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+esp_err_t MIRROR_load(nvs_handle_t nvs_handle)
+{
+    static mirror_blob_t blob;
+    size_t value_len = 0;
+
+    esp_err_t err = nvs_get_blob(nvs_handle, KEY_RAM_MIRROR, NULL, &value_len); // only get the length
+    if (err != ESP_OK)
+        return err;
+    if (value_len > sizeof(blob))
+        return ESP_ERR_INVALID_SIZE; // written by a newer firmware
+
+    err = nvs_get_blob(nvs_handle, KEY_RAM_MIRROR, &blob, &value_len);
+    if (err != ESP_OK)
+        return err;
+
+    // the legacy layouts have no header, they are told apart by their size
+    if (value_len == sizeof(mirror_stored_t))
+    {
+        const mirror_header_t* header = &blob.current.header;
+        if (header->version != RAM_MIRROR_VERSION || header->len != sizeof(ram_mirror_t) ||
+            header->crc != mirror_crc(&blob.current.rm))
+        {
+            PRINT_LOG("Invalid header: version %u len %u", header->version, header->len);
+            return ESP_ERR_INVALID_CRC;
+        }
+        rm = blob.current.rm;
+    }
+    else if (value_len == sizeof(ram_mirror_v1_t) && blob.v1.magic_word == RAM_MIRROR_VALID_MAGIC)
+    {
+        PRINT_LOG("Migrating from version 1");
+        migrate_v1(&blob.v1);
+    }
+    else
+    {
+        PRINT_LOG("Unknown layout, %u bytes", value_len);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    MIRROR_checkpoint();
+    return ESP_OK;
+}
+
+esp_err_t MIRROR_save(nvs_handle_t nvs_handle)
+{
+    static mirror_stored_t stored;
+
+    stored.rm = rm;
+    stored.header.version = RAM_MIRROR_VERSION;
+    stored.header.len = sizeof(ram_mirror_t);
+    stored.header.crc = mirror_crc(&stored.rm);
+
+    MIRROR_checkpoint();
+    return nvs_set_blob(nvs_handle, KEY_RAM_MIRROR, &stored, sizeof(stored));
+}
+
+void MIRROR_checkpoint(void)
+{
+    portENTER_CRITICAL(&checkpoint_mux);
+    rtc_header.version = RAM_MIRROR_VERSION;
+    rtc_header.len = sizeof(ram_mirror_t);
+    rtc_header.crc = mirror_crc(&rm);
+    portEXIT_CRITICAL(&checkpoint_mux);
+}
+
+bool MIRROR_rtc_valid(void)
+{
+    return rtc_header.version == RAM_MIRROR_VERSION && rtc_header.len == sizeof(ram_mirror_t) &&
+        rtc_header.crc == mirror_crc(&rm) && rm.magic_word == RAM_MIRROR_VALID_MAGIC;
+}
@@ -2,22 +2,46 @@
 
 #include "custom_main.h"
 
-#include <math.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_cpu.h"      // for cycle counter
+#include "esp_rom_sys.h"  // for CPU ticks per us
 
 #include "driver/uart.h"
+#include "esp_system.h"   // for reset reason
+#include "esp_rtc_time.h" // for RTC timer, keeps running through soft resets
 #include "driver/gptimer.h"
 #include "bsp.h"
 
 #include "timekeep.h"
 #include "TinyGPS_wrapper.h"
+#include "trace.h"
+#include "ds3231.h"
+#include "gps_stats.h"
+#include "drift.h"
+#include "mirror.h"
+#include "dfs.h"
+#include "latency.h"
+#include "clocksync.h"
+#include "ubx.h"
 
 
 #define SECOND_TIMER_PERIOD_US 1000000ULL
 #define UART_BLOCK_TICKS 2000
 
+#define TIME_ANCHOR_MAGIC 0x414E4348 // "ANCH"
+
+// Last known time and the RTC timer value at that moment. Lives in RTC RAM which is not initialized
+// by the bootloader, so it survives software resets, panics and watchdog resets (but not power loss).
+typedef struct
+{
+    uint32_t magic;
+    time_t utc;
+    uint64_t rtc_us;
+} time_anchor_t;
+
 /* Configure parameters of an UART driver, communication pins and install the driver */
 const uart_config_t uart_config = {
     .baud_rate = 9600,
@@ -37,26 +61,277 @@ const int intr_alloc_flags =
 
 
 static volatile time_t mcu_utc;
+static esp_timer_handle_t periodic_timer;
+static bool timer_running = false;
+static volatile bool provisional = false; // running on a time source which was not yet verified by GPS
+static RTC_NOINIT_ATTR time_anchor_t anchor;
+static int64_t last_tick_us; // for the period jitter, 0 after (re)starting the timer
 
+// latest second tick, TIMEKEEP fetches it after a TASK_NOTIFY_TICK
+static task_msg_t tick_msg = {.dst = TASK_TIMEKEEP, .cmd = TASK_CMD_SECOND_TICK };
+static uint32_t tick_seq; // to detect ticks which TIMEKEEP did not get to
+static portMUX_TYPE tick_mux = portMUX_INITIALIZER_UNLOCKED;
 
+// parser throughput since the last NEO6M_print_stats()
+static struct
+{
+    uint32_t bytes;
+    uint32_t sentences;
+    uint32_t accepted; // timestamps
+    uint64_t encode_ns;
+#if NMEA_CAPTURE
+    uint32_t capture_dropped; // lines, UART busy for longer than MAX_LOG_WAIT_MS
+#endif // NMEA_CAPTURE
+} parser_stats;
+static int64_t parser_stats_start_us;
+static portMUX_TYPE parser_mux = portMUX_INITIALIZER_UNLOCKED;
 
-static void periodic_timer_callback(void* arg)
+
+// With SECOND_TICK_ISR this runs in the esp_timer ISR, so it has to stay short and IRAM safe
+static void IRAM_ATTR periodic_timer_callback(void* arg)
 {
-    static task_msg_t msg = {.dst = TASK_TIMEKEEP, .cmd = TASK_CMD_SECOND_TICK }; // prepare message
+    int64_t now_us = esp_timer_get_time();
     mcu_utc++;
-    msg.utc_time = mcu_utc;
 
-    sendTaskMessageISR(&msg);
+    if (last_tick_us != 0)
+    {
+        int64_t deviation_us = now_us - last_tick_us - (int64_t)SECOND_TIMER_PERIOD_US;
+        LATENCY_record_us(LATENCY_STAGE_TICK_PERIOD, (deviation_us < 0) ? -deviation_us : deviation_us);
+    }
+    last_tick_us = now_us;
+
+    portENTER_CRITICAL_SAFE(&tick_mux);
+    tick_msg.tick_us = now_us;
+    tick_msg.utc_time = mcu_utc;
+    tick_msg.provisional = provisional;
+    tick_seq++;
+    portEXIT_CRITICAL_SAFE(&tick_mux);
+
+#if SECOND_TICK_ISR
+    if (notifyTaskISR(TASK_TIMEKEEP, TASK_NOTIFY_TICK))
+    {
+        esp_timer_isr_dispatch_need_yield();
+    }
+#else
+    sendTaskMessageISR(&tick_msg);
+#endif // SECOND_TICK_ISR
 }
 
 static const esp_timer_create_args_t periodic_timer_args =
 {
     .callback = &periodic_timer_callback,
+#if SECOND_TICK_ISR
+    .dispatch_method = ESP_TIMER_ISR, // needs CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#endif // SECOND_TICK_ISR
     /* name is optional, but may help identify the timer when debugging */
     .name = "secTimer"
 };
 
+static void start_ticking(time_t utc)
+{
+    mcu_utc = utc;
+    last_tick_us = 0;
+    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, SECOND_TIMER_PERIOD_US));
+    timer_running = true;
+}
+
+// Try to get the time from the RTC, so the slave clocks can catch up without waiting for the GPS fix
+static bool seed_from_rtc(void)
+{
+    time_t rtc_utc;
+
+    if (DS3231_init() != ESP_OK)
+    {
+        return false;
+    }
+
+    esp_err_t err = DS3231_read_utc(&rtc_utc);
+    if (err != ESP_OK)
+    {
+        PRINT_LOG("RTC time not usable: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    if (rtc_utc < rm.last_connected_utc) // time can not run backwards, RTC was likely never set
+    {
+        PRINT_LOG("RTC time %lld before last connection %lld, ignoring", rtc_utc, rm.last_connected_utc);
+        return false;
+    }
+
+    start_ticking(rtc_utc);
+    PRINT_LOG("Started from RTC, utc: %lld", rtc_utc);
+    return true;
+}
+
+// After a software reset the time can be estimated from the anchor and the still running RTC timer
+static bool seed_from_anchor(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool rtc_kept = reason == ESP_RST_SW || reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+        reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT || reason == ESP_RST_DEEPSLEEP;
+
+    if (!rtc_kept || anchor.magic != TIME_ANCHOR_MAGIC)
+    {
+        return false;
+    }
+
+    time_t utc;
+    if (!CLOCKSYNC_anchor_utc(anchor.utc, anchor.rtc_us, esp_rtc_get_time_us(), &utc))
+    {
+        PRINT_LOG("Time anchor too old or invalid");
+        return false;
+    }
+
+    start_ticking(utc);
+    PRINT_LOG("Started from anchor, utc: %lld, %llds since anchor", mcu_utc, utc - anchor.utc);
+    return true;
+}
+
+#if NMEA_CAPTURE
+/* Whole lines are written under the UART lock, so they do not get mixed up with log messages.
+ * Waiting like PRINT_LOG does: the receiver does not wait for us, rather lose a line than the following bytes. */
+static void capture_byte(char c)
+{
+    static char line[NMEA_CAPTURE_LINE_LEN + 1];
+    static uint8_t len;
 
+    line[len++] = c;
+    if (c != '\n' && len < NMEA_CAPTURE_LINE_LEN)
+        return;
+
+    line[len] = 0;
+    len = 0;
+    if (xUartSemaphore == NULL || xSemaphoreTake(xUartSemaphore, MAX_LOG_WAIT_MS) != pdTRUE)
+    {
+        portENTER_CRITICAL(&parser_mux);
+        parser_stats.capture_dropped++;
+        portEXIT_CRITICAL(&parser_mux);
+        return;
+    }
+    snprintf(print_buf, MAX_LOG_LEN, "%s", line);
+    serial_print_custom();
+    xSemaphoreGive(xUartSemaphore);
+}
+#endif // NMEA_CAPTURE
+
+/* Hand the last known position and, if we already tick on a provisional time, the current time to the
+ * receiver (UBX-AID-INI). This turns a cold start into a warm start, if the almanac is still valid.
+ * Stored ephemeris (AID-EPH) is not used: TinyGPS only parses NMEA, we never get to see the ephemeris. */
+static void send_aiding(void)
+{
+    static uint8_t frame[UBX_AID_INI_LEN + UBX_FRAME_OVERHEAD];
+    uint8_t payload[UBX_AID_INI_LEN];
+    ubx_aid_t aid =
+    {
+        .pos_valid = rm.last_pos_valid,
+        .lat_e7 = rm.last_lat_e7,
+        .lon_e7 = rm.last_lon_e7,
+        .alt_valid = rm.last_alt_cm != TINYGPS_WRAPPER_INVALID_ALTITUDE,
+        .alt_cm = rm.last_alt_cm,
+        .time_valid = timer_running,
+        .utc = mcu_utc,
+    };
+
+    uint32_t flags = UBX_aid_ini_payload(payload, &aid);
+    if (flags == 0)
+    {
+        PRINT_LOG("Nothing to aid the receiver with");
+        return;
+    }
+
+    size_t len = UBX_frame(frame, sizeof(frame), UBX_CLASS_AID, UBX_ID_AID_INI, payload, sizeof(payload));
+    uart_write_bytes(NEO6M_UART, frame, len);
+    PRINT_LOG("Sent AID-INI, flags: %02lX", flags);
+}
+
+// Remember where we are, for aiding after the next restart
+static void store_position(void)
+{
+    int32_t lat_e7, lon_e7, alt_cm;
+    uint32_t age;
+
+    if (TinyGPS_wrapper_get_position(&lat_e7, &lon_e7, &alt_cm, &age) == 0)
+    {
+        rm.last_lat_e7 = lat_e7;
+        rm.last_lon_e7 = lon_e7;
+        rm.last_alt_cm = alt_cm;
+        rm.last_pos_valid = 1;
+    }
+}
+
+// Keep the RTC disciplined to GPS, so it is close when the next power loss happens
+static void sync_rtc(time_t gps_utc, uint32_t age)
+{
+    static time_t last_sync_utc = 0; // first fix after boot always syncs
+
+    if (!DS3231_present() || age > DS3231_SYNC_MAX_AGE_MS)
+    {
+        return;
+    }
+    if ((gps_utc - last_sync_utc) < DS3231_SYNC_INTERVAL_S)
+    {
+        return;
+    }
+
+    time_t rtc_utc;
+    if (DS3231_read_utc(&rtc_utc) == ESP_OK)
+    {
+        PRINT_LOG("RTC deviation from GPS: %llds", rtc_utc - gps_utc);
+    }
+
+    esp_err_t err = DS3231_write_utc(gps_utc);
+    if (err != ESP_OK)
+    {
+        PRINT_LOG("Unable to set RTC: %s", esp_err_to_name(err));
+        return;
+    }
+    last_sync_utc = gps_utc;
+}
+
+
+
+void NEO6M_update_anchor(const task_msg_t* tick)
+{
+    // esp_rtc_get_time_us() takes a lock and is not IRAM safe, so it can not be read in the tick ISR.
+    // Take it now and subtract the time since the tick instead.
+    int64_t since_tick_us = esp_timer_get_time() - tick->tick_us;
+
+    // invalidate it while updating in case of a reset in between
+    anchor.magic = 0;
+    anchor.utc = tick->utc_time;
+    anchor.rtc_us = esp_rtc_get_time_us() - since_tick_us;
+    anchor.magic = TIME_ANCHOR_MAGIC;
+}
+
+uint32_t NEO6M_get_tick(task_msg_t* msg)
+{
+    portENTER_CRITICAL(&tick_mux);
+    *msg = tick_msg;
+    uint32_t seq = tick_seq;
+    portEXIT_CRITICAL(&tick_mux);
+    return seq;
+}
+
+void NEO6M_print_stats(void)
+{
+    portENTER_CRITICAL(&parser_mux);
+    typeof(parser_stats) stats = parser_stats;
+    parser_stats = (typeof(parser_stats)){0};
+    portEXIT_CRITICAL(&parser_mux);
+
+    int64_t now_us = esp_timer_get_time();
+    int64_t elapsed_ms = (now_us - parser_stats_start_us) / 1000;
+    parser_stats_start_us = now_us;
+    if (stats.bytes == 0 || elapsed_ms <= 0)
+        return;
+
+    PRINT_LOG("NMEA parser: %lu bytes, %lu sentences (%llu/min), %lu timestamps accepted, encode %lluns/byte",
+        stats.bytes, stats.sentences, stats.sentences * 60000ULL / elapsed_ms, stats.accepted,
+        stats.encode_ns / stats.bytes);
+#if NMEA_CAPTURE
+    PRINT_LOG("NMEA capture: %lu lines dropped", stats.capture_dropped); // the capture has gaps if not 0
+#endif // NMEA_CAPTURE
+}
 
 void NEO6M_Task(void *parameter)
 {
@@ -66,6 +341,10 @@ void NEO6M_Task(void *parameter)
     char buf;
     struct tm gps_local_time = {0}; 
     uint32_t age;
+    time_t last_drift_utc = 0; // only sample the first sentence of each second
+#if TRACE_ENABLE
+    bool in_sentence = false; // traced per line, per byte would fill the trace buffer within a second
+#endif // TRACE_ENABLE
 
     GPS_LOCK_STATE_t lock_state = GPS_LOCK_UNINITIALIZED;
 
@@ -75,11 +354,15 @@ void NEO6M_Task(void *parameter)
     ESP_ERROR_CHECK(uart_set_pin(NEO6M_UART, NEO6M_TX_PIN, NEO6M_RX_PIN, GPIO_NUM_NC, GPIO_NUM_NC));
 
     // setup periodic timer for local timekeeping
-    esp_timer_handle_t periodic_timer;
     ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
 
+    // start with a provisional time if possible, corrected on the first GPS fix
+    provisional = seed_from_rtc() || seed_from_anchor();
+    send_aiding();
+
     while(1)
     {
+        DFS_release(DFS_LOCK_GPS_PARSE); // end of the previous sentence, if any
         int res = uart_read_bytes(NEO6M_UART, &buf, sizeof(buf), UART_BLOCK_TICKS); // normally data should frequently come in
         if (res <= 0) 
         { // timed out or any other error
@@ -87,61 +370,108 @@ void NEO6M_Task(void *parameter)
             {
                 PRINT_LOG("No GPS signal");
                 lock_state = GPS_LOCK_LOST;
+                GPS_STATS_lock_changed(false);
                 msg_locked.lock_state = GPS_LOCK_LOST;
                 sendTaskMessage(&msg_locked);
             }
             continue;
         }
 
-        if (TinyGPS_wrapper_encode(buf) == false)
+#if NMEA_CAPTURE
+        capture_byte(buf);
+#endif // NMEA_CAPTURE
+
+#if TRACE_ENABLE
+        if (buf == '$' || (buf == '\n' && in_sentence))
+        { // a '$' also ends a line cut short
+            if (in_sentence)
+                TRACE_END(TRACE_ID_GPS_SENTENCE);
+            in_sentence = (buf == '$');
+            if (in_sentence)
+                TRACE_BEGIN(TRACE_ID_GPS_SENTENCE);
+        }
+#endif // TRACE_ENABLE
+
+        uint32_t encode_cycles = esp_cpu_get_cycle_count();
+        bool sentence_done = TinyGPS_wrapper_encode(buf);
+        encode_cycles = esp_cpu_get_cycle_count() - encode_cycles;
+
+        portENTER_CRITICAL(&parser_mux);
+        parser_stats.bytes++;
+        parser_stats.encode_ns += (uint64_t)encode_cycles * 1000 / esp_rom_get_cpu_ticks_per_us(); // DFS changes the frequency
+        parser_stats.sentences += sentence_done;
+        portEXIT_CRITICAL(&parser_mux);
+
+        if (sentence_done == false)
         { // not yet done parsing
             continue;
         }
+        DFS_acquire(DFS_LOCK_GPS_PARSE);
+        int64_t sentence_us = esp_timer_get_time();
         
         // interpret received data
+        TRACE_BEGIN(TRACE_ID_GPS_CRACK_DATETIME);
         res = TinyGPS_wrapper_crack_datetime(&gps_local_time, &rm.last_connected_utc, &age);
+        TRACE_END(TRACE_ID_GPS_CRACK_DATETIME);
         if (res != 0)
         {
             PRINT_LOG("Unable to crack datetime, result: %d", res);
             continue;
         }
+        portENTER_CRITICAL(&parser_mux);
+        parser_stats.accepted++;
+        portEXIT_CRITICAL(&parser_mux);
+#if NMEA_CAPTURE
+        PRINT_LOG("Accepted utc %lld age %lu", rm.last_connected_utc, age);
+#endif // NMEA_CAPTURE
+
+        if (rm.last_connected_utc != last_drift_utc)
+        { // age is the time since the sentence was parsed
+            last_drift_utc = rm.last_connected_utc;
+            DRIFT_record(rm.last_connected_utc, esp_timer_get_time() - age * 1000LL);
+        }
         
-        if (lock_state == GPS_LOCK_UNINITIALIZED)
+        if (!timer_running || provisional)
         {
-            mcu_utc = rm.last_connected_utc;
-
-            // start cyclic timer
-            ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, SECOND_TIMER_PERIOD_US));
+            if (!timer_running) // else: already running on provisional time, gets corrected below if needed
+            {
+                start_ticking(rm.last_connected_utc);
+            }
 
-            PRINT_LOG("Inital lock, age: %lu mcu utc: %lld last connected utc: %lld", age, mcu_utc, rm.last_connected_utc);
+            uint32_t ttff_ms = ESP_IDF_MILLIS(); // after a soft reset the receiver may already have had its fix
+            GPS_STATS_first_fix(ttff_ms);
+            PRINT_LOG("Inital lock, age: %lu mcu utc: %lld last connected utc: %lld, TTFF: %lums",
+                age, mcu_utc, rm.last_connected_utc, ttff_ms);
         }
+        store_position();
+        sync_rtc(rm.last_connected_utc, age);
 
         if (lock_state != GPS_LOCKED) // avoid sending same message over and over, if lock did not change
         {
             lock_state = GPS_LOCKED;
+            GPS_STATS_lock_changed(true);
             msg_locked.lock_state = GPS_LOCKED;
             sendTaskMessage(&msg_locked);
         }
 
         // determine time difference between local clock and received time
-        double clock_diff = difftime(mcu_utc, rm.last_connected_utc);
-        if (fabs(clock_diff) > MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS)
+        time_t clock_diff = mcu_utc - rm.last_connected_utc;
+        if (CLOCKSYNC_drift_correction(clock_diff, provisional, &rm.total_pos_time_corrected, &rm.total_neg_time_corrected))
         { // too great, adjust
             ESP_ERROR_CHECK(esp_timer_stop(periodic_timer)); // halt timer, it does read-modify-write of the variable (not atomic)!
             mcu_utc = rm.last_connected_utc; // set new UTC timestamp
+            last_tick_us = 0;
             ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, SECOND_TIMER_PERIOD_US)); // restart timer
 
-            PRINT_LOG("Local clock drifted by: %lf, halting and re-adjusting to %lld", clock_diff, mcu_utc);
+            PRINT_LOG("Local clock drifted by: %llds, halting and re-adjusting to %lld", clock_diff, mcu_utc);
+        }
 
-            // Accumulate the total drifted time into separate counters
-            if (clock_diff > 0)
-            {
-                rm.total_pos_time_corrected += clock_diff;
-            }
-            else
-            {
-                rm.total_neg_time_corrected += -clock_diff;
-            }
+        if (provisional)
+        {
+            PRINT_LOG("Provisional time verified by GPS, was off by %llds", clock_diff);
+            provisional = false;
         }
+        MIRROR_checkpoint(); // time, position and stats changed
+        LATENCY_record(LATENCY_STAGE_GPS_PARSE, sentence_us);
     }
 }
\ No newline at end of file
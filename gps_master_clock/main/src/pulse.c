@@ -0,0 +1,122 @@
+#include "pulse.h"
+
+#include <string.h>
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void PULSE_init(pulse_t* pulse, uint16_t len_ms, uint16_t pause_ms)
+{
+    memset(pulse, 0, sizeof(*pulse));
+    pulse->len_ms = len_ms;
+    pulse->pause_ms = pause_ms;
+    pulse->phase = PULSE_IDLE;
+}
+
+uint32_t PULSE_missed_ticks(pulse_t* pulse, uint32_t seq)
+{
+    uint32_t missed = 0;
+    if (pulse->last_seq != 0 && seq - pulse->last_seq > 1)
+    {
+        missed = seq - pulse->last_seq - 1;
+    }
+    pulse->last_seq = seq;
+    return missed;
+}
+
+bool PULSE_tick(pulse_t* pulse, time_t utc)
+{
+    bool full_minute = CLOCKSYNC_minute_crossed(pulse->last_tick_utc, utc);
+    pulse->last_tick_utc = utc;
+    return full_minute && !pulse->commissioning;
+}
+
+clocksync_action_t PULSE_minute_sync(pulse_t* pulse, int face_minutes, int target_minutes, bool provisional,
+    int* minutes)
+{
+    // position of the hands once a pulse in progress is complete
+    int face = (face_minutes + (pulse->phase != PULSE_IDLE)) % MINUTES_PER_12H;
+
+    pulse->face_check = !pulse->face_logged[provisional];
+    pulse->face_provisional = provisional;
+
+    clocksync_action_t action = CLOCKSYNC_minute_sync(face, target_minutes, provisional, minutes);
+    if (action == CLOCKSYNC_WAIT_LEAD || action == CLOCKSYNC_WAIT_PROVISIONAL)
+    {
+        pulse->minutes_diff = -*minutes; // no pulses
+    }
+    else
+    {
+        pulse->minutes_diff = *minutes;
+    }
+    return action;
+}
+
+void PULSE_commissioning(pulse_t* pulse, bool on)
+{
+    pulse->commissioning = on;
+    pulse->minutes_diff = 0;
+}
+
+void PULSE_advance(pulse_t* pulse, int minutes)
+{
+    if (pulse->commissioning)
+    { // force the pulses
+        pulse->minutes_diff = minutes;
+    }
+}
+
+void PULSE_shutdown(pulse_t* pulse)
+{
+    pulse->shutdown_pending = true; // a cut off pulse might not advance the slave clock
+}
+
+int64_t PULSE_wakeup_us(const pulse_t* pulse)
+{
+    if (pulse->phase != PULSE_IDLE)
+        return pulse->next_us;
+    if (pulse->minutes_diff > 0 || pulse->shutdown_pending)
+        return 0;
+    return PULSE_NO_WAKEUP;
+}
+
+uint32_t PULSE_step(pulse_t* pulse, int64_t now_us, int* face_minutes)
+{
+    uint32_t events = 0;
+
+    if (pulse->phase == PULSE_ACTIVE && now_us >= pulse->next_us)
+    {
+        pulse->next_us += pulse->pause_ms * 1000;
+        pulse->phase = PULSE_PAUSE;
+        events |= PULSE_EV_HIGH;
+    }
+    else if (pulse->phase == PULSE_PAUSE && now_us >= pulse->next_us)
+    {
+        *face_minutes = (*face_minutes + 1) % MINUTES_PER_12H; // one step closer to the target time
+        pulse->phase = PULSE_IDLE;
+        events |= PULSE_EV_DONE;
+    }
+
+    if (pulse->phase == PULSE_IDLE && pulse->shutdown_pending)
+    {
+        pulse->shutdown_pending = false;
+        return events | PULSE_EV_SUSPEND;
+    }
+
+    if (pulse->phase == PULSE_IDLE && pulse->minutes_diff > 0) // no backwards pulses possible
+    {
+        pulse->next_us = now_us + pulse->len_ms * 1000;
+        pulse->phase = PULSE_ACTIVE;
+        pulse->minutes_diff--; // counts the pulses not yet started
+        events |= PULSE_EV_START;
+    }
+
+    if (pulse->face_check && pulse->minutes_diff == 0 && pulse->phase == PULSE_IDLE)
+    {
+        pulse->face_check = false;
+        pulse->face_logged[pulse->face_provisional] = true;
+        events |= PULSE_EV_FACE;
+    }
+    return events;
+}
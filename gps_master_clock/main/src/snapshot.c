@@ -0,0 +1,107 @@
+#include "snapshot.h"
+
+#include <stdio.h>
+
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "mirror.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define SNAPSHOT_MAGIC  0x50414E53 // "SNAP"
+#define SLOT_ERASED     0xFFFFFFFF
+#define SLOT_SIZE       ((sizeof(snapshot_slot_t) + 15) & ~15)
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint32_t magic;
+    uint32_t crc; // over the snapshot
+    snapshot_t snapshot;
+} snapshot_slot_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static const esp_partition_t* partition;
+static uint32_t num_slots;
+static uint32_t next_slot; // num_slots if full
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+esp_err_t SNAPSHOT_init(snapshot_t* newest, bool* found)
+{
+    static snapshot_slot_t slot;
+
+    *found = false;
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SNAPSHOT_PARTITION_LABEL);
+    if (partition == NULL)
+    {
+        PRINT_LOG("No snapshot partition");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    num_slots = partition->size / SLOT_SIZE;
+
+    // slots are used in order, the first erased one ends the scan
+    for (next_slot = 0; next_slot < num_slots; next_slot++)
+    {
+        esp_err_t err = esp_partition_read(partition, next_slot * SLOT_SIZE, &slot, sizeof(slot));
+        if (err != ESP_OK)
+            return err;
+        if (slot.magic == SLOT_ERASED)
+            break;
+
+        if (slot.magic == SNAPSHOT_MAGIC &&
+            slot.crc == esp_rom_crc32_le(0, (const uint8_t*)&slot.snapshot, sizeof(slot.snapshot)))
+        {
+            *newest = slot.snapshot;
+            *found = true;
+        }
+    }
+    return ESP_OK;
+}
+
+// Called from the power fail handling, keep it short: one flash program operation of ~150 bytes
+esp_err_t SNAPSHOT_save(void)
+{
+    static snapshot_slot_t slot;
+
+    if (partition == NULL)
+        return ESP_ERR_INVALID_STATE;
+    if (next_slot >= num_slots)
+        return ESP_ERR_NO_MEM; // only erased at boot, the caller has to fall back to NVS
+
+    rm.mirror_saved_times++; // tells which one is newer, snapshot or NVS
+    MIRROR_checkpoint();
+    slot.magic = SNAPSHOT_MAGIC;
+    slot.snapshot.rm = rm; // the CRC is over this copy
+    GPS_STATS_get(&slot.snapshot.gps_stats);
+    slot.crc = esp_rom_crc32_le(0, (const uint8_t*)&slot.snapshot, sizeof(slot.snapshot));
+
+    esp_err_t err = esp_partition_write(partition, next_slot * SLOT_SIZE, &slot, sizeof(slot));
+    next_slot++; // also on error, the slot might be partially programmed
+    return err;
+}
+
+esp_err_t SNAPSHOT_clear(void)
+{
+    if (partition == NULL)
+        return ESP_ERR_INVALID_STATE;
+    if (next_slot == 0)
+        return ESP_OK; // still erased
+
+    esp_err_t err = esp_partition_erase_range(partition, 0, partition->size);
+    if (err == ESP_OK)
+    {
+        next_slot = 0;
+    }
+    return err;
+}
@@ -0,0 +1,91 @@
+#include "stats.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"  // for vTaskGetRunTimeStats
+#include "esp_system.h" // for the heap size
+
+#include "custom_main.h"
+#include "trace.h"
+#include "latency.h"
+#include "i2c_bus.h"
+#include "gps_stats.h"
+#include "dfs.h"
+#include "isr_profile.h"
+#include "neo6m.h"
+#include "timekeep.h"
+#include "drift.h"
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static void print_general(void)
+{
+    static uint8_t last_num_tasks = 0;
+    static char* runtime_stat_buffer_ptr; // ~40B per task, 
+
+    // some general stats:
+    PRINT_LOG(
+        "General:\n"
+        "\tFree heap: %lu, minimum free heap: %lu\n"
+        "\tTotal corrected: pos:%lus neg:%lus\n"
+        "\tUptime: %lus = %luh = %lud",
+        esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+        rm.total_pos_time_corrected, rm.total_neg_time_corrected,
+        rm.total_uptime_seconds, rm.total_uptime_seconds / 3600, rm.total_uptime_seconds / (3600 * 24)
+    );
+    uint8_t curr_num_tasks = uxTaskGetNumberOfTasks();
+    if (last_num_tasks != curr_num_tasks)
+    { // number of tasks changed, re-allocate
+        if (runtime_stat_buffer_ptr)
+        { // free old buffer
+            vPortFree(runtime_stat_buffer_ptr);
+            runtime_stat_buffer_ptr = NULL;
+        }
+
+        PRINT_LOG("Re-allocating, task num changed from %u to %u", last_num_tasks, curr_num_tasks);
+
+        // see :https://www.freertos.org/Documentation/02-Kernel/04-API-references/03-Task-utilities/00-Task-utilities#vtaskgetruntimestats
+        // around 40B per task -> double it for safety
+        runtime_stat_buffer_ptr = pvPortMalloc(80 * curr_num_tasks);
+        if (runtime_stat_buffer_ptr)
+        { // if allocation worked: remember new amount of tasks
+            last_num_tasks = curr_num_tasks;
+        }
+    }
+    if (runtime_stat_buffer_ptr != NULL) // make sure allocation worked
+    {
+        vTaskGetRunTimeStats(runtime_stat_buffer_ptr);
+        PRINT_LOG("Runtime stats:\n%s", runtime_stat_buffer_ptr);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void STATS_Task(void *parameter)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t intervals = 0;
+
+    while (1)
+    {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(STATS_INTERVAL_S * 1000));
+
+        print_general();
+        TIMEKEEP_print_stats();
+        GPS_STATS_print();
+        NEO6M_print_stats();
+        I2C_BUS_print_stats();
+        DFS_print_stats();
+        ISR_PROFILE_PRINT();
+        LATENCY_print_stats();
+        TRACE_DUMP();
+
+        if (++intervals % (DRIFT_DUMP_INTERVAL_S / STATS_INTERVAL_S) == 0)
+        {
+            DRIFT_dump();
+        }
+    }
+}
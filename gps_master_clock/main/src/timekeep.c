@@ -1,60 +1,88 @@
 #include "timekeep.h"
 
 #include <string.h> // for string copy and other functions
+#include <stdlib.h> // for setenv
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"  // for vTaskGetRunTimeStats
+#include "freertos/task.h"  // for vTaskSuspend
 
 #include "custom_main.h"
 #include "bsp.h"
-
+#include "trace.h"
+#include "latency.h"
+#include "journal.h"
+#include "mirror.h"
+#include "dfs.h"
+#include "neo6m.h"
+#include "pulse.h"
 
 // Set timezone for Europe/Berlin (https://github.com/nayarsystems/posix_tz_db/blob/master/zones.csv)
 static const char* timezone_europe_berlin = "CET-1CEST,M3.5.0,M10.5.0/3";
 static const char* timezone_gmt = "GMT0";
 
 static SemaphoreHandle_t tz_mutex;
+static uint32_t wakeups; // of the task, ideally only the ticks and pulse transitions
+static pulse_t pulse;
 
-
-static void print_stats(void)
+// blocking time until a pulse transition, rounded up so the phase is never cut short
+static TickType_t ticks_until(int64_t time_us)
 {
-    static uint8_t last_num_tasks = 0;
-    static char* runtime_stat_buffer_ptr; // ~40B per task, 
-
-    // some general stats:
-    PRINT_LOG(
-        "General:\n"
-        "\tFree heap: %lu, minimum free heap: %lu\n"
-        "\tTotal corrected: pos:%lus neg:%lus\n"
-        "\tUptime: %lus = %luh = %lud",
-        esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
-        rm.total_pos_time_corrected, rm.total_neg_time_corrected,
-        rm.total_uptime_seconds, rm.total_uptime_seconds / 3600, rm.total_uptime_seconds / (3600 * 24)
-    );
-    uint8_t curr_num_tasks = uxTaskGetNumberOfTasks();
-    if (last_num_tasks != curr_num_tasks)
-    { // number of tasks changed, re-allocate
-        if (runtime_stat_buffer_ptr)
-        { // free old buffer
-            vPortFree(runtime_stat_buffer_ptr);
-            runtime_stat_buffer_ptr = NULL;
-        }
+    if (time_us == PULSE_NO_WAKEUP)
+        return portMAX_DELAY;
 
-        PRINT_LOG("Re-allocating, task num changed from %u to %u", last_num_tasks, curr_num_tasks);
+    int64_t remaining_us = time_us - esp_timer_get_time();
+    if (remaining_us <= 0)
+        return 0;
+    return (remaining_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+}
 
-        // see :https://www.freertos.org/Documentation/02-Kernel/04-API-references/03-Task-utilities/00-Task-utilities#vtaskgetruntimestats
-        // around 40B per task -> double it for safety
-        runtime_stat_buffer_ptr = pvPortMalloc(80 * curr_num_tasks);
-        if (runtime_stat_buffer_ptr)
-        { // if allocation worked: remember new amount of tasks
-            last_num_tasks = curr_num_tasks;
-        }
-    }
-    if (runtime_stat_buffer_ptr != NULL) // make sure allocation worked
+/* Next message for TIMEKEEP. With SECOND_TICK_ISR the tick arrives as a direct notification from the timer
+ * ISR, the other messages still come through the queue and are announced by TASK_NOTIFY_MSG. */
+static bool timekeep_receive(TickType_t timeout, task_msg_t* msg)
+{
+#if SECOND_TICK_ISR
+    static uint32_t pending; // notification bits not yet handled
+    bool waited = false;
+
+    while (1)
     {
-        vTaskGetRunTimeStats(runtime_stat_buffer_ptr);
-        PRINT_LOG("Runtime stats:\n%s", runtime_stat_buffer_ptr);
+        if (pending & TASK_NOTIFY_TICK)
+        {
+            pending &= ~TASK_NOTIFY_TICK;
+            uint32_t missed = PULSE_missed_ticks(&pulse, NEO6M_get_tick(msg));
+            if (missed > 0)
+            {
+                PRINT_LOG("Missed %lu tick(s)", missed);
+                rm.total_uptime_seconds += missed;
+            }
+            return true;
+        }
+        if ((pending & TASK_NOTIFY_MSG) && receiveTaskMessage(TASK_TIMEKEEP, 0, msg))
+        {
+            return true; // keep the bit, there might be more messages
+        }
+        pending = 0;
+
+        if (waited || xTaskNotifyWait(0, UINT32_MAX, &pending, timeout) != pdTRUE)
+            return false;
+        waited = true;
     }
+#else
+    return receiveTaskMessage(TASK_TIMEKEEP, timeout, msg);
+#endif // SECOND_TICK_ISR
+}
+
+void TIMEKEEP_print_stats(void)
+{
+    static uint32_t last_wakeups; // only TIMEKEEP writes the counter, so it is not reset here
+    static int64_t last_us;
+    int64_t now_us = esp_timer_get_time();
+    uint32_t count = wakeups - last_wakeups;
+    uint32_t interval_s = (now_us - last_us) / 1000000;
+
+    PRINT_LOG("Timekeep wakeups: %lu in %lus (%lu/s)", count, interval_s, interval_s ? count / interval_s : 0);
+    last_wakeups += count;
+    last_us = now_us;
 }
 
 void take_tz_mutex(void)
@@ -78,60 +106,62 @@ void give_tz_mutex(void)
 void TIMEKEEP_Task(void *parameter)
 {
     static task_msg_t local_time_msg = {.dst = TASK_LCD, .cmd = TASK_CMD_LOCAL_TIME };
-    int clock_minutes_diff = 0; // difference to correct time
+    int64_t pulse_tick_us = 0; // tick which started the current pulse train, for latency measurement
     struct tm target_local_time; // from conversion from received UTC to localtime
     task_msg_t msg; // scratch buffer for receiving task messages
     char* timezone_env_ptr = NULL; // points to heap, where timezone string will be buffered
-    bool commissioning = false;
 
+    PULSE_init(&pulse, rm.pulse_len_ms, rm.pulse_pause_ms);
     gpio_set_direction(GPIO_LED, GPIO_MODE_INPUT_OUTPUT);
 
     while(1)
     {
-        if (receiveTaskMessage(TASK_TIMEKEEP, 10, &msg) == true)
+        // block until the next message, or the next pulse transition during a pulse train
+        bool received = timekeep_receive(ticks_until(PULSE_wakeup_us(&pulse)), &msg);
+        wakeups++;
+
+        if (received)
         {
             switch(msg.cmd)
             {
                 case TASK_CMD_SHUTDOWN:
                 {
-                    gpio_set_level(GPIO_LED, 0); // disable LED to save a bit power
-                    vTaskSuspend(NULL);
+                    PULSE_shutdown(&pulse);
                     break;
                 }
 
                 case TASK_CMD_START_COMMISSIONING:
                 case TASK_CMD_STOP_COMMISSIONING:
                 {
-                    commissioning = (msg.cmd == TASK_CMD_START_COMMISSIONING);
-                    clock_minutes_diff = 0;
+                    PULSE_commissioning(&pulse, msg.cmd == TASK_CMD_START_COMMISSIONING);
                     break;
                 }
                 case TASK_CMD_SLAVE_ADVANCE_MINUTE:
                 case TASK_CMD_SLAVE_ADVANCE_HOUR:
                 {
-                    if (commissioning)
-                    { // force one tick
-                        clock_minutes_diff = (msg.cmd == TASK_CMD_SLAVE_ADVANCE_MINUTE) ? 1 : 60;
-                    }
-                    
+                    PULSE_advance(&pulse, (msg.cmd == TASK_CMD_SLAVE_ADVANCE_MINUTE) ? 1 : 60);
                     break;
                 }
                 case TASK_CMD_SECOND_TICK:
                 {
+                    LATENCY_record(LATENCY_STAGE_TIMEKEEP_RX, msg.tick_us);
                     rm.total_uptime_seconds++;
-                    if (rm.total_uptime_seconds % 60 == 0)
-                    {
-                        print_stats();
-                    }
+                    MIRROR_checkpoint();
+                    NEO6M_update_anchor(&msg);
+                    bool full_minute = PULSE_tick(&pulse, msg.utc_time);
 
-                    if (commissioning == true) // if commissioning right now -> skip all of the handling
+                    if (pulse.commissioning == true) // if commissioning right now -> skip all of the handling
                     {
                         continue;
                     }
 
-                    // Toggle LED to indicate activity
-                    gpio_set_level(GPIO_LED, gpio_get_level(GPIO_LED) ? 0 : 1);
+                    // Toggle LED to indicate activity, it is also the pulse output
+                    if (pulse.phase == PULSE_IDLE)
+                    {
+                        gpio_set_level(GPIO_LED, gpio_get_level(GPIO_LED) ? 0 : 1);
+                    }
 
+                    TRACE_BEGIN(TRACE_ID_LOCALTIME);
                     take_tz_mutex(); // wait until we can manipulate the timezone
 
                     /* Timezone/env handling in general is really messed up in newlib. Calling it over and over WILL
@@ -157,51 +187,41 @@ void TIMEKEEP_Task(void *parameter)
                     }
 
                     give_tz_mutex(); // other processes can use the timezone again
+                    TRACE_END(TRACE_ID_LOCALTIME);
+                    LATENCY_record(LATENCY_STAGE_LOCALTIME, msg.tick_us);
 
                     local_time_msg.local_time = target_local_time;
+                    local_time_msg.tick_us = msg.tick_us;
+                    local_time_msg.provisional = msg.provisional;
                     sendTaskMessage(&local_time_msg);
             
-                    if (target_local_time.tm_sec != 0) // only sync at full minutes
+                    // only sync at full minutes. If the tick of second 0 was missed, this is the first one after it
+                    if (!full_minute)
                     {
                         continue;
                     }
 
                     int target_minutes_12o_clock = target_local_time.tm_hour * 60 + target_local_time.tm_min;
-
-                    // determine the current difference
-                    clock_minutes_diff = target_minutes_12o_clock - rm.current_minutes_12o_clock;
-                    clock_minutes_diff = clock_minutes_diff % MINUTES_PER_12H;
-
-                    if (clock_minutes_diff > 0)
+                    int minutes;
+                    clocksync_action_t action = PULSE_minute_sync(&pulse, rm.current_minutes_12o_clock,
+                        target_minutes_12o_clock, msg.provisional, &minutes);
+                    if (action == CLOCKSYNC_WAIT_LEAD || action == CLOCKSYNC_WAIT_PROVISIONAL)
                     {
-                        int minutes_lead = (clock_minutes_diff + MAX_LOCAL_CLOCK_LEAD_MINUTES) % MINUTES_PER_12H;
-
-                        // caution around 12'o clock position: if our local time is 00:00 or after, and the
-                        // received GPS time is before 00:00 -> large difference, where it would make sense to wait!
-                        if (minutes_lead < MAX_LOCAL_CLOCK_LEAD_MINUTES)
-                        {
-                            clock_minutes_diff = -minutes_lead; // this way is 'shorter'
-                            PRINT_LOG("Local time leads slightly, with the GPS time about to wrap");
-                            continue;
-                        }
+                        PRINT_LOG("Local time leads by %d minutes, waiting%s", minutes,
+                            (action == CLOCKSYNC_WAIT_PROVISIONAL) ? " for GPS instead of wrapping around on provisional time" : " ...");
+                        continue;
                     }
-                    else if (clock_minutes_diff < 0) // can not set counter clockwise difference, need special handling
+                    else if (action == CLOCKSYNC_WRAP_AROUND)
                     {
-                        if (clock_minutes_diff < -MAX_LOCAL_CLOCK_LEAD_MINUTES) // if difference too large -> need to wrap around
-                        {
-                            clock_minutes_diff = MINUTES_PER_12H - clock_minutes_diff;
-                            PRINT_LOG("Local time leads too much, wrapping around");
-                        }
-                        else // difference is not too much, we can just wait
-                        {
-                            PRINT_LOG("Local time slightly leads, waiting %d minutes ...", clock_minutes_diff);
-                            continue;
-                        }
+                        PRINT_LOG("Local time leads too much, wrapping around");
                     }
 
+                    // position of the hands once a pulse in progress is complete, as the sync took it
+                    int face_minutes_12o_clock = (rm.current_minutes_12o_clock + (pulse.phase != PULSE_IDLE)) % MINUTES_PER_12H;
+                    pulse_tick_us = msg.tick_us;
                     PRINT_LOG("%02d:%02d -> %d minutes time difference to target -> %02d:%02d(%02d:%02d)",
-                        rm.current_minutes_12o_clock / 60, rm.current_minutes_12o_clock % 60,
-                        clock_minutes_diff,
+                        face_minutes_12o_clock / 60, face_minutes_12o_clock % 60,
+                        minutes,
                         target_local_time.tm_hour % 12, target_local_time.tm_min,
                         target_local_time.tm_hour, target_local_time.tm_min);
                     break;
@@ -213,20 +233,41 @@ void TIMEKEEP_Task(void *parameter)
             }
         } // else: no new messages
 
-        if (clock_minutes_diff > 0) // no backwards pulses possible
-        { // if we come here: do clock pulses
-            // set GPIO(s)
-            gpio_set_level(GPIO_LED, 0);
-            vTaskDelay(rm.pulse_len_ms / portTICK_PERIOD_MS);
+        // pulse transitions, timed by the receive timeout above instead of delaying the whole task
+        uint32_t events = PULSE_step(&pulse, esp_timer_get_time(), &rm.current_minutes_12o_clock);
+        if (events & PULSE_EV_HIGH)
+        {
             // set GPIO(s)
             gpio_set_level(GPIO_LED, 1);
-            vTaskDelay(rm.pulse_pause_ms / portTICK_PERIOD_MS);
-
+        }
+        if (events & PULSE_EV_DONE)
+        {
             // Set GPIO(s)
             gpio_set_level(GPIO_LED, 0);
-            rm.current_minutes_12o_clock++; // one step closer to the target time
-            rm.current_minutes_12o_clock %= MINUTES_PER_12H; // keep within 12 hour bounds
-            clock_minutes_diff--;
+            JOURNAL_record_position(rm.current_minutes_12o_clock);
+            MIRROR_checkpoint();
+            DFS_release(DFS_LOCK_PULSE);
+            TRACE_END(TRACE_ID_PULSE);
+        }
+        if (events & PULSE_EV_SUSPEND)
+        {
+            gpio_set_level(GPIO_LED, 0); // disable LED to save a bit power
+            vTaskSuspend(NULL);
+            continue;
+        }
+        if (events & PULSE_EV_START)
+        { // if we come here: start the next clock pulse
+            TRACE_BEGIN(TRACE_ID_PULSE);
+            DFS_acquire(DFS_LOCK_PULSE);
+            // set GPIO(s)
+            gpio_set_level(GPIO_LED, 0);
+            LATENCY_record(LATENCY_STAGE_PULSE_EDGE, pulse_tick_us);
+            pulse_tick_us = 0; // only the first edge of a train is related to the tick
+        }
+        if (events & PULSE_EV_FACE)
+        { // time since the esp_timer started, the bootloader adds a few 100ms before that
+            PRINT_LOG("Clock face shows %s time %lums after boot",
+                pulse.face_provisional ? "provisional" : "GPS", ESP_IDF_MILLIS());
         }
     }
 }
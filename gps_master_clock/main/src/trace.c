@@ -0,0 +1,195 @@
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"      // for cycle counter
+#include "esp_rom_sys.h"  // for CPU ticks per us
+
+#include "custom_main.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define TID_ISR             0   // interrupt context, the tasks are numbered from 1 on
+#define DUMP_CHUNK_LINES    16  // JSON lines per UART mutex hold, the other tasks can log in between
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+typedef struct
+{
+    uint32_t cycles; // CPU cycle counter of the recording core
+    uint8_t id;      // trace_id_t
+    uint8_t begin;   // begin or end of the section
+    uint8_t core;    // the cycle counters are per core
+    uint8_t tid;     // TID_ISR or index in trace_tasks + 1
+} trace_event_t;
+
+//---------------------------------------------------------------------------
+// Local constants
+//---------------------------------------------------------------------------
+
+static const char* trace_names[] =
+{
+    [TRACE_ID_GPS_SENTENCE]         = "NMEA sentence",
+    [TRACE_ID_GPS_CRACK_DATETIME]   = "TinyGPS_wrapper_crack_datetime",
+    [TRACE_ID_LOCALTIME]            = "localtime",
+    [TRACE_ID_LCD_DEFAULT_DISPLAYS] = "LCD_print_default_displays",
+    [TRACE_ID_PULSE]                = "pulse",
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
+static trace_event_t trace_buf[TRACE_BUF_LEN];
+static uint32_t trace_head; // next index to write
+static uint32_t trace_cnt;  // valid events in buffer
+static volatile bool trace_frozen; // no recording while dumping
+static TaskHandle_t trace_tasks[TRACE_MAX_TASKS]; // in the order of their first event
+static uint8_t trace_num_tasks;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// call with trace_mux taken. Begin/end pairs of different tasks on one core interleave, the viewers only
+// nest them correctly per thread
+static uint8_t IRAM_ATTR get_tid(void)
+{
+    if (xPortInIsrContext())
+        return TID_ISR;
+
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    uint8_t idx = 0;
+    while (idx < trace_num_tasks && trace_tasks[idx] != task)
+        idx++;
+    if (idx == trace_num_tasks)
+    {
+        if (trace_num_tasks == TRACE_MAX_TASKS)
+            return TRACE_MAX_TASKS; // shared by the surplus tasks
+        trace_tasks[trace_num_tasks++] = task;
+    }
+    return idx + 1;
+}
+
+// waits as long as needed, but lets other tasks log in between
+static void take_uart(void)
+{
+    while (xSemaphoreTake(xUartSemaphore, pdMS_TO_TICKS(MAX_LOG_WAIT_MS)) != pdTRUE)
+    {
+        vTaskDelay(1); // let the current log finish
+    }
+}
+
+// prints the trace_buf lines [from, to), call with xUartSemaphore taken
+static void dump_events(uint32_t from, uint32_t to, uint64_t* last_cycles, uint64_t* first_cycles)
+{
+    uint32_t start = (trace_head + TRACE_BUF_LEN - trace_cnt) % TRACE_BUF_LEN;
+    uint32_t ticks_per_us = esp_rom_get_cpu_ticks_per_us();
+
+    for (uint32_t idx = from; idx < to; idx++)
+    {
+        const trace_event_t* ev = &trace_buf[(start + idx) % TRACE_BUF_LEN];
+        uint64_t cycles = (last_cycles[ev->core] & ~0xFFFFFFFFULL) | ev->cycles;
+        if (cycles < last_cycles[ev->core]) // counter wrapped since the last event
+        {
+            cycles += 1ULL << 32;
+        }
+        last_cycles[ev->core] = cycles;
+        if (first_cycles[ev->core] == 0)
+        {
+            first_cycles[ev->core] = cycles;
+        }
+
+        uint64_t ts = (cycles - first_cycles[ev->core]) / ticks_per_us;
+        snprintf(print_buf, MAX_LOG_LEN, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":%u,\"tid\":%u},\n",
+            trace_names[ev->id], ev->begin ? 'B' : 'E', ts, ev->core, ev->tid);
+        serial_print_custom();
+    }
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void IRAM_ATTR TRACE_record(trace_id_t id, bool begin)
+{
+    if (trace_frozen)
+        return;
+
+    portENTER_CRITICAL_SAFE(&trace_mux);
+    trace_event_t* ev = &trace_buf[trace_head];
+    ev->cycles = esp_cpu_get_cycle_count();
+    ev->id = id;
+    ev->begin = begin;
+    ev->core = esp_cpu_get_core_id();
+    ev->tid = get_tid();
+
+    trace_head = (trace_head + 1) % TRACE_BUF_LEN;
+    if (trace_cnt < TRACE_BUF_LEN)
+        trace_cnt++;
+    portEXIT_CRITICAL_SAFE(&trace_mux);
+}
+
+/* Prints the buffered events as Chrome trace JSON, everything between the "traceEvents" line and the
+ * closing bracket can be stored to a file and opened in ui.perfetto.dev or chrome://tracing. The cycle
+ * counters wrap every ~18s at 240MHz, they are unwrapped per core which assumes no larger gaps between events.
+ * The counters of both cores are not synchronized, so each core is a process ("pid") with its own timeline
+ * starting at 0, the tasks are its threads ("tid"). The UART is released every DUMP_CHUNK_LINES, so the dump
+ * is interleaved with other log lines, which have to be removed before loading it. Nothing is recorded until
+ * the dump is done. */
+void TRACE_dump(void)
+{
+    uint64_t last_cycles[portNUM_PROCESSORS] = {0};
+    uint64_t first_cycles[portNUM_PROCESSORS] = {0};
+
+    if (xUartSemaphore == NULL)
+        return;
+
+    portENTER_CRITICAL(&trace_mux);
+    trace_frozen = true;
+    portEXIT_CRITICAL(&trace_mux);
+
+    take_uart();
+    snprintf(print_buf, MAX_LOG_LEN, "{\"traceEvents\":[\n");
+    serial_print_custom();
+    for (uint32_t idx = 0; idx < trace_cnt; )
+    {
+        uint32_t end = (idx + DUMP_CHUNK_LINES < trace_cnt) ? idx + DUMP_CHUNK_LINES : trace_cnt;
+        dump_events(idx, end, last_cycles, first_cycles);
+        idx = end;
+        xSemaphoreGive(xUartSemaphore);
+        take_uart();
+    }
+
+    // thread names last, the ISR line of the last core has no trailing comma
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        for (uint8_t idx = 0; idx < trace_num_tasks; idx++)
+        {
+            snprintf(print_buf, MAX_LOG_LEN,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n",
+                core, idx + 1, pcTaskGetName(trace_tasks[idx]));
+            serial_print_custom();
+        }
+        snprintf(print_buf, MAX_LOG_LEN,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"ISR\"}}%s\n",
+            core, TID_ISR, (core + 1 < portNUM_PROCESSORS) ? "," : "");
+        serial_print_custom();
+    }
+    snprintf(print_buf, MAX_LOG_LEN, "]}\n");
+    serial_print_custom();
+    xSemaphoreGive(xUartSemaphore);
+
+    trace_cnt = 0; // start over
+    trace_frozen = false;
+}
+
+#endif // TRACE_ENABLE
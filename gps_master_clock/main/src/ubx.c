@@ -0,0 +1,86 @@
+#include "ubx.h"
+
+#include <string.h>
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static void put_u32_le(uint8_t* dst, uint32_t val)
+{
+    dst[0] = val;
+    dst[1] = val >> 8;
+    dst[2] = val >> 16;
+    dst[3] = val >> 24;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+uint32_t UBX_aid_ini_payload(uint8_t payload[UBX_AID_INI_LEN], const ubx_aid_t* aid)
+{
+    uint32_t flags = 0;
+
+    memset(payload, 0, UBX_AID_INI_LEN);
+
+    if (aid->pos_valid)
+    {
+        flags |= UBX_AID_INI_FLAG_POS | UBX_AID_INI_FLAG_LLA;
+        put_u32_le(&payload[0], aid->lat_e7);
+        put_u32_le(&payload[4], aid->lon_e7);
+        if (aid->alt_valid)
+        {
+            put_u32_le(&payload[8], aid->alt_cm);
+        }
+        else
+        {
+            flags |= UBX_AID_INI_FLAG_ALTINV;
+        }
+        put_u32_le(&payload[12], UBX_AID_INI_POS_ACC_CM);
+    }
+
+    if (aid->time_valid)
+    {
+        uint32_t gps_s = aid->utc - GPS_EPOCH_UTC + GPS_LEAP_SECONDS;
+        uint16_t wn = gps_s / SECONDS_PER_WEEK;
+
+        flags |= UBX_AID_INI_FLAG_TIME;
+        payload[18] = wn;
+        payload[19] = wn >> 8;
+        put_u32_le(&payload[20], (gps_s % SECONDS_PER_WEEK) * 1000); // time of week in ms
+        put_u32_le(&payload[28], UBX_AID_INI_TIME_ACC_MS);
+    }
+
+    put_u32_le(&payload[44], flags);
+    return flags;
+}
+
+size_t UBX_frame(uint8_t* frame, size_t frame_len, uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t len)
+{
+    uint8_t ck_a = 0, ck_b = 0;
+
+    if (frame_len < (size_t)len + UBX_FRAME_OVERHEAD)
+    {
+        return 0;
+    }
+
+    frame[0] = UBX_SYNC_1;
+    frame[1] = UBX_SYNC_2;
+    frame[2] = cls;
+    frame[3] = id;
+    frame[4] = len;
+    frame[5] = len >> 8;
+    memcpy(&frame[6], payload, len);
+
+    // 8 bit fletcher checksum over class, id, length and payload
+    for (uint16_t idx = 2; idx < len + 6; idx++)
+    {
+        ck_a += frame[idx];
+        ck_b += ck_a;
+    }
+    frame[len + 6] = ck_a;
+    frame[len + 7] = ck_b;
+
+    return len + UBX_FRAME_OVERHEAD;
+}
@@ -0,0 +1,97 @@
+#ifndef _MOCK_H_
+#define _MOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_system.h"
+#include "driver/gpio.h"
+
+/* Control of the host mocks which replace ESP-IDF and FreeRTOS. Everything runs in the test's thread on a
+ * virtual microsecond clock: it only moves when a mock advances it, e.g. for a delay, a blocking call which
+ * times out or the duration of an I2C transfer. */
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+// runs the work of another task while the test blocks, returns true if it did something
+typedef bool (*mock_blocked_hook_t)(void);
+
+typedef struct mock_i2c_device
+{
+    uint16_t addr;
+    uint32_t stretch_us; // clock stretching, added to every transfer
+    // executes a transfer, tx is empty for a read only one. NULL: the device only acknowledges
+    esp_err_t (*xfer)(struct mock_i2c_device* dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len);
+    void* ctx;
+} mock_i2c_device_t;
+
+// one executed transfer
+typedef struct
+{
+    uint16_t addr;
+    size_t tx_len;
+    size_t rx_len;
+    int64_t start_us;
+    int64_t end_us;
+    esp_err_t result;
+} mock_i2c_xfer_t;
+
+// one gpio_set_level() call
+typedef struct
+{
+    gpio_num_t gpio;
+    uint8_t level;
+    int64_t us;
+} mock_gpio_level_t;
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+void MOCK_advance_us(int64_t us);
+void MOCK_set_blocked_hook(mock_blocked_hook_t hook);
+
+/* Runs a task function until it ends itself: vTaskSuspend(NULL), or MOCK_end_task() from a mock, e.g. the UART
+ * once everything was received. The task state in static variables is kept for the next run. */
+void MOCK_run_task(void (*task)(void* parameter), void* parameter);
+void MOCK_end_task(void);
+
+// creates the log UART mutex, PRINT_LOG output is shown with UNIT_VERBOSE=1 in the environment
+void MOCK_log_init(void);
+
+/* Simulated I2C bus at the speed of the device config: 9 clocks per byte including the address byte(s),
+ * plus the clock stretching. A transfer which takes longer than its timeout ends with ESP_ERR_TIMEOUT,
+ * one to an address without device with ESP_FAIL (NACK). */
+void MOCK_I2C_reset(void);
+void MOCK_I2C_attach(mock_i2c_device_t* dev);
+const mock_i2c_xfer_t* MOCK_I2C_log(size_t* cnt);
+
+// In-memory NVS with a single namespace, the blobs are kept until the next reset or nvs_flash_erase()
+void MOCK_NVS_reset(void);
+
+/* Emulated NOR flash behind the data partitions of partitions.csv: erased is 0xFF, programming can only clear
+ * bits. MOCK_FLASH_cut_after() simulates a power loss: after ops more write/erase operations, the next one only
+ * gets partial_bytes done. From then on every flash access fails until MOCK_FLASH_power_on() (the reboot). */
+void MOCK_FLASH_reset(void);
+void MOCK_FLASH_cut_after(uint32_t ops, size_t partial_bytes);
+void MOCK_FLASH_power_on(void);
+uint32_t MOCK_FLASH_erase_count(const char* label, uint32_t sector);
+
+// Every gpio_set_level() is logged with the virtual time, like the I2C transfers
+void MOCK_GPIO_reset(void);
+const mock_gpio_level_t* MOCK_GPIO_log(size_t* cnt);
+
+// Received by the UART at 9600 baud, the receiving task ends once it has read everything
+void MOCK_UART_receive(const char* data);
+
+// For the next boot: the reset reason and the RTC timer at the current virtual time
+void MOCK_set_reset_reason(esp_reset_reason_t reason, int64_t rtc_us);
+
+// Instead of TinyGPS: each line is a sentence with this time, 0 for no fix (see mock_gps.c)
+void MOCK_GPS_set_fix(time_t utc);
+
+#endif // _MOCK_H_
@@ -0,0 +1,45 @@
+#ifndef _UNIT_H_
+#define _UNIT_H_
+
+#include <stdio.h>
+
+/* Minimal assertion helpers for the host tests. A failed check is reported and counted, the test goes on,
+ * UNIT_RESULT() turns the count into the exit code for ctest. */
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define CHECK(cond) do { \
+        if (!(cond)) \
+        { \
+            unit_failures++; \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+        long long _a = (long long)(actual), _e = (long long)(expected); \
+        if (_a != _e) \
+        { \
+            unit_failures++; \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                __FILE__, __LINE__, #actual, #expected, _a, _e); \
+        } \
+    } while (0)
+
+#define RUN(test) do { \
+        int _before = unit_failures; \
+        test(); \
+        printf("%-40s %s\n", #test, (unit_failures == _before) ? "ok" : "FAILED"); \
+    } while (0)
+
+#define UNIT_RESULT() (unit_failures ? 1 : 0)
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static int unit_failures;
+
+#endif
@@ -0,0 +1,22 @@
+#include "dfs.h"
+
+// No frequency scaling on the host
+
+esp_err_t DFS_init(void)
+{
+    return ESP_OK;
+}
+
+void DFS_acquire(dfs_lock_t lock)
+{
+    (void)lock;
+}
+
+void DFS_release(dfs_lock_t lock)
+{
+    (void)lock;
+}
+
+void DFS_print_stats(void)
+{
+}
@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include "esp_partition.h"
+
+#include "mock.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define SECTOR_SIZE     4096
+#define JOURNAL_SIZE    (64 * 1024)
+#define SNAPSHOT_SIZE   (4 * 1024)
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+// data partitions of partitions.csv
+static const esp_partition_t partitions[] =
+{
+    { ESP_PARTITION_TYPE_DATA, 0x40, 0x110000, JOURNAL_SIZE, SECTOR_SIZE, "journal" },
+    { ESP_PARTITION_TYPE_DATA, 0x41, 0x120000, SNAPSHOT_SIZE, SECTOR_SIZE, "snapshot" },
+};
+
+static uint8_t journal_flash[JOURNAL_SIZE];
+static uint8_t snapshot_flash[SNAPSHOT_SIZE];
+static uint8_t* const flash[] = { journal_flash, snapshot_flash };
+static uint32_t erase_counts[JOURNAL_SIZE / SECTOR_SIZE + SNAPSHOT_SIZE / SECTOR_SIZE];
+
+static bool powered = true;
+static uint32_t ops_until_cut = UINT32_MAX;
+static size_t cut_bytes;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static uint8_t* partition_data(const esp_partition_t* partition)
+{
+    return flash[partition - partitions];
+}
+
+static bool in_range(const esp_partition_t* partition, size_t offset, size_t size)
+{
+    return offset <= partition->size && size <= partition->size - offset;
+}
+
+// counts the write/erase operations, returns how many bytes the current one gets done
+static size_t power_check(size_t size)
+{
+    if (ops_until_cut == 0)
+    {
+        powered = false;
+        ops_until_cut = UINT32_MAX;
+        return (cut_bytes < size) ? cut_bytes : size;
+    }
+    if (ops_until_cut != UINT32_MAX)
+    {
+        ops_until_cut--;
+    }
+    return size;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void MOCK_FLASH_reset(void)
+{
+    memset(journal_flash, 0xFF, sizeof(journal_flash));
+    memset(snapshot_flash, 0xFF, sizeof(snapshot_flash));
+    memset(erase_counts, 0, sizeof(erase_counts));
+    MOCK_FLASH_power_on();
+}
+
+void MOCK_FLASH_cut_after(uint32_t ops, size_t partial_bytes)
+{
+    ops_until_cut = ops;
+    cut_bytes = partial_bytes;
+}
+
+void MOCK_FLASH_power_on(void)
+{
+    powered = true;
+    ops_until_cut = UINT32_MAX;
+}
+
+uint32_t MOCK_FLASH_erase_count(const char* label, uint32_t sector)
+{
+    uint32_t first = 0;
+    for (size_t idx = 0; idx < sizeof(partitions) / sizeof(partitions[0]); idx++)
+    {
+        if (strcmp(partitions[idx].label, label) == 0)
+            return erase_counts[first + sector];
+        first += partitions[idx].size / SECTOR_SIZE;
+    }
+    return 0;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+    const char* label)
+{
+    for (size_t idx = 0; idx < sizeof(partitions) / sizeof(partitions[0]); idx++)
+    {
+        if (partitions[idx].type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || partitions[idx].subtype == subtype) &&
+            (label == NULL || strcmp(partitions[idx].label, label) == 0))
+        {
+            return &partitions[idx];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size)
+{
+    if (!powered)
+        return ESP_FAIL;
+    if (!in_range(partition, src_offset, size))
+        return ESP_ERR_INVALID_SIZE;
+
+    memcpy(dst, partition_data(partition) + src_offset, size);
+    return ESP_OK;
+}
+
+// NOR flash: programming can only clear bits
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size)
+{
+    if (!powered)
+        return ESP_FAIL;
+    if (!in_range(partition, dst_offset, size))
+        return ESP_ERR_INVALID_SIZE;
+
+    size_t done = power_check(size);
+    uint8_t* data = partition_data(partition) + dst_offset;
+    for (size_t idx = 0; idx < done; idx++)
+    {
+        data[idx] &= ((const uint8_t*)src)[idx];
+    }
+    return powered ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size)
+{
+    if (!powered)
+        return ESP_FAIL;
+    if (!in_range(partition, offset, size) || offset % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0)
+        return ESP_ERR_INVALID_ARG;
+
+    size_t done = power_check(size);
+    memset(partition_data(partition) + offset, 0xFF, done);
+
+    uint32_t first = 0;
+    for (const esp_partition_t* part = partitions; part < partition; part++)
+    {
+        first += part->size / SECTOR_SIZE;
+    }
+    for (size_t sector = offset / SECTOR_SIZE; sector < (offset + size) / SECTOR_SIZE; sector++)
+    {
+        erase_counts[first + sector]++;
+    }
+    return powered ? ESP_OK : ESP_FAIL;
+}
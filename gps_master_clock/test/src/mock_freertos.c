@@ -0,0 +1,320 @@
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "mock.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define DEADLOCK_TICKS  (3600 * configTICK_RATE_HZ) // portMAX_DELAY without anyone to give: test bug
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static int64_t now_us;
+static mock_blocked_hook_t blocked_hook;
+static bool in_hook;
+
+static struct esp_timer
+{
+    esp_timer_create_args_t args;
+    bool created;
+    bool running;
+    int64_t period_us;
+    int64_t next_us;
+} timer;
+
+static uint32_t notify_value;
+static jmp_buf task_exit;
+static bool task_running;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// one round of waiting: let the other task work, else let the time pass. False once the timeout is over.
+static bool wait_tick(TickType_t timeout, TickType_t* waited)
+{
+    if (blocked_hook != NULL && !in_hook)
+    {
+        in_hook = true;
+        bool progress = blocked_hook();
+        in_hook = false;
+        if (progress)
+            return true;
+    }
+
+    if (*waited >= timeout)
+        return false;
+    if (timeout == portMAX_DELAY && *waited >= DEADLOCK_TICKS)
+    {
+        fprintf(stderr, "mock: blocked forever\n");
+        abort();
+    }
+    MOCK_advance_us(portTICK_PERIOD_MS * 1000);
+    (*waited)++;
+    return true;
+}
+
+static SemaphoreHandle_t sem_init(StaticSemaphore_t* buffer, UBaseType_t max, UBaseType_t initial)
+{
+    buffer->max = max;
+    buffer->count = initial;
+    return buffer;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void MOCK_advance_us(int64_t us)
+{
+    int64_t end_us = now_us + us;
+    while (timer.running && timer.next_us <= end_us)
+    { // the callback sees the time it was due at
+        now_us = timer.next_us;
+        timer.next_us += timer.period_us;
+        timer.args.callback(timer.args.arg);
+    }
+    now_us = end_us;
+}
+
+void MOCK_set_blocked_hook(mock_blocked_hook_t hook)
+{
+    blocked_hook = hook;
+}
+
+void MOCK_run_task(void (*task)(void* parameter), void* parameter)
+{
+    notify_value = 0;
+    if (setjmp(task_exit) == 0)
+    {
+        task_running = true;
+        task(parameter);
+    }
+    task_running = false;
+}
+
+void MOCK_end_task(void)
+{
+    if (!task_running)
+    {
+        fprintf(stderr, "mock: no task to end\n");
+        abort();
+    }
+    longjmp(task_exit, 1);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle)
+{
+    if (timer.created)
+        return ESP_ERR_NO_MEM;
+    timer.args = *create_args;
+    timer.created = true;
+    *out_handle = &timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t handle, uint64_t period)
+{
+    if (handle->running)
+        return ESP_ERR_INVALID_STATE;
+    handle->period_us = period;
+    handle->next_us = now_us + period;
+    handle->running = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t handle)
+{
+    if (!handle->running)
+        return ESP_ERR_INVALID_STATE;
+    handle->running = false;
+    return ESP_OK;
+}
+
+void esp_timer_isr_dispatch_need_yield(void)
+{
+}
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    static char name[16];
+    snprintf(name, sizeof(name), "0x%x", code);
+    return name;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer)
+{
+    return sem_init(buffer, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer)
+{
+    return sem_init(buffer, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max, UBaseType_t initial, StaticSemaphore_t* buffer)
+{
+    return sem_init(buffer, max, initial);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_init(malloc(sizeof(StaticSemaphore_t)), 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_init(malloc(sizeof(StaticSemaphore_t)), 1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout)
+{
+    TickType_t waited = 0;
+    while (sem->count == 0)
+    {
+        if (!wait_tick(timeout, &waited))
+            return pdFALSE;
+    }
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->count >= sem->max)
+        return pdFALSE;
+    sem->count++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* woken)
+{
+    if (woken)
+        *woken = pdFALSE;
+    return xSemaphoreGive(sem);
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t len, UBaseType_t item_size, uint8_t* storage, StaticQueue_t* buffer)
+{
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->storage = storage;
+    buffer->len = len;
+    buffer->item_size = item_size;
+    return buffer;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t timeout)
+{
+    TickType_t waited = 0;
+    while (queue->cnt == queue->len)
+    {
+        if (!wait_tick(timeout, &waited))
+            return pdFALSE;
+    }
+    UBaseType_t idx = (queue->head + queue->cnt) % queue->len;
+    memcpy(queue->storage + idx * queue->item_size, item, queue->item_size);
+    queue->cnt++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken)
+{
+    if (woken)
+        *woken = pdFALSE;
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t timeout)
+{
+    TickType_t waited = 0;
+    while (queue->cnt == 0)
+    {
+        if (!wait_tick(timeout, &waited))
+            return pdFALSE;
+    }
+    memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->len;
+    queue->cnt--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->cnt;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    MOCK_advance_us((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t period)
+{
+    *previous_wake += period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*previous_wake - now) > 0)
+    {
+        vTaskDelay(*previous_wake - now);
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us / (portTICK_PERIOD_MS * 1000));
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    (void)task;
+    if (action == eSetBits)
+        notify_value |= value;
+    else if (action == eIncrement)
+        notify_value++;
+    else if (action != eNoAction)
+        notify_value = value;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* woken)
+{
+    if (woken)
+        *woken = pdFALSE;
+    return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t timeout)
+{
+    TickType_t waited = 0;
+    notify_value &= ~clear_on_entry;
+    while (notify_value == 0)
+    {
+        if (!wait_tick(timeout, &waited))
+            return pdFALSE;
+    }
+    if (value)
+        *value = notify_value;
+    notify_value &= ~clear_on_exit;
+    return pdTRUE;
+}
+
+void vTaskSuspend(TaskHandle_t task)
+{
+    if (task == NULL)
+        MOCK_end_task();
+}
@@ -0,0 +1,51 @@
+#include <stdbool.h>
+
+#include "TinyGPS_wrapper.h"
+
+#include "mock.h"
+
+/* Replaces TinyGPS_wrapper.cpp for the task tests: every received line is a sentence, it carries the time set
+ * with MOCK_GPS_set_fix(). Parsing real NMEA is covered by test_nmea_replay. */
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static time_t fix_utc; // 0: no fix
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void MOCK_GPS_set_fix(time_t utc)
+{
+    fix_utc = utc;
+}
+
+bool TinyGPS_wrapper_encode(char c)
+{
+    return c == '\n';
+}
+
+int TinyGPS_wrapper_crack_datetime(struct tm* local, time_t* utc, uint32_t* age)
+{
+    if (fix_utc == 0)
+        return -1;
+
+    *utc = fix_utc;
+    gmtime_r(utc, local);
+    *age = 0;
+    return 0;
+}
+
+int TinyGPS_wrapper_get_position(int32_t* lat_e7, int32_t* lon_e7, int32_t* alt_cm, uint32_t* age)
+{
+    if (fix_utc == 0)
+        return -1;
+
+    *lat_e7 = 481372000; // Munich
+    *lon_e7 = 115755000;
+    *alt_cm = 52000;
+    *age = 0;
+    return 0;
+}
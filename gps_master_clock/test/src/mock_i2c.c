@@ -0,0 +1,162 @@
+#include <stdlib.h>
+
+#include "driver/i2c_master.h"
+#include "esp_timer.h"
+
+#include "mock.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define MAX_DEVICES     8
+#define LOG_LEN         1024 // transfers, the oldest are dropped
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+struct i2c_master_bus
+{
+    int unused;
+};
+
+struct i2c_master_dev
+{
+    uint16_t addr;
+    uint32_t scl_speed_hz;
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static struct i2c_master_bus bus;
+static struct i2c_master_dev handles[MAX_DEVICES];
+static uint8_t num_handles;
+
+static mock_i2c_device_t* devices[MAX_DEVICES];
+static uint8_t num_devices;
+
+static mock_i2c_xfer_t xfer_log[LOG_LEN];
+static size_t log_cnt;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static mock_i2c_device_t* find(uint16_t addr)
+{
+    for (uint8_t idx = 0; idx < num_devices; idx++)
+    {
+        if (devices[idx]->addr == addr)
+            return devices[idx];
+    }
+    return NULL;
+}
+
+static esp_err_t xfer(i2c_master_dev_handle_t handle, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len,
+    int timeout_ms)
+{
+    mock_i2c_device_t* dev = find(handle->addr);
+    mock_i2c_xfer_t* entry = &xfer_log[log_cnt++ % LOG_LEN];
+
+    // address byte per direction, 9 clocks per byte with the ACK
+    size_t bytes = (tx_len > 0) + tx_len + (rx_len > 0) + rx_len;
+    int64_t duration_us = (int64_t)bytes * 9 * 1000000 / handle->scl_speed_hz;
+    esp_err_t result = ESP_OK;
+
+    entry->addr = handle->addr;
+    entry->tx_len = tx_len;
+    entry->rx_len = rx_len;
+    entry->start_us = esp_timer_get_time();
+
+    if (dev == NULL)
+    {
+        duration_us = 9 * 1000000 / handle->scl_speed_hz; // address byte only
+        result = ESP_FAIL;
+    }
+    else
+    {
+        duration_us += dev->stretch_us;
+        if (duration_us > (int64_t)timeout_ms * 1000)
+        {
+            duration_us = (int64_t)timeout_ms * 1000;
+            result = ESP_ERR_TIMEOUT;
+        }
+        else if (dev->xfer != NULL)
+        {
+            result = dev->xfer(dev, tx, tx_len, rx, rx_len);
+        }
+    }
+
+    MOCK_advance_us(duration_us);
+    entry->end_us = esp_timer_get_time();
+    entry->result = result;
+    return result;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void MOCK_I2C_reset(void)
+{
+    num_devices = 0;
+    log_cnt = 0;
+}
+
+void MOCK_I2C_attach(mock_i2c_device_t* dev)
+{
+    if (num_devices < MAX_DEVICES)
+    {
+        devices[num_devices++] = dev;
+    }
+}
+
+const mock_i2c_xfer_t* MOCK_I2C_log(size_t* cnt)
+{
+    *cnt = (log_cnt < LOG_LEN) ? log_cnt : LOG_LEN;
+    return xfer_log;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t* bus_config, i2c_master_bus_handle_t* ret_bus_handle)
+{
+    (void)bus_config;
+    num_handles = 0;
+    *ret_bus_handle = &bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t* dev_config,
+    i2c_master_dev_handle_t* ret_handle)
+{
+    (void)bus_handle;
+    if (num_handles >= MAX_DEVICES)
+        return ESP_ERR_NO_MEM;
+
+    handles[num_handles].addr = dev_config->device_address;
+    handles[num_handles].scl_speed_hz = dev_config->scl_speed_hz;
+    *ret_handle = &handles[num_handles++];
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t* write_buffer, size_t write_size,
+    int xfer_timeout_ms)
+{
+    return xfer(i2c_dev, write_buffer, write_size, NULL, 0, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t* write_buffer,
+    size_t write_size, uint8_t* read_buffer, size_t read_size, int xfer_timeout_ms)
+{
+    return xfer(i2c_dev, write_buffer, write_size, read_buffer, read_size, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus_handle, uint16_t address, int xfer_timeout_ms)
+{
+    (void)bus_handle;
+    (void)xfer_timeout_ms;
+    MOCK_advance_us(90); // address byte at 100kHz
+    return (find(address) != NULL) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,119 @@
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "custom_main.h"
+#include "mock.h"
+
+// What main.c provides to the other modules
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define QUEUE_LEN       16 // per task, the tests drain them in the blocked hook
+
+//---------------------------------------------------------------------------
+// Exported var/func
+//---------------------------------------------------------------------------
+
+SemaphoreHandle_t xUartSemaphore;
+char print_buf[MAX_LOG_LEN];
+ram_mirror_t rm;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static StaticQueue_t queue_buffers[TASK_TIMEKEEP + 1];
+static uint8_t queue_storage[TASK_TIMEKEEP + 1][QUEUE_LEN * sizeof(task_msg_t)];
+static QueueHandle_t queues[TASK_TIMEKEEP + 1];
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static QueueHandle_t queue(task_type_t dst)
+{
+    if (dst > TASK_TIMEKEEP)
+        return NULL;
+    if (queues[dst] == NULL)
+    {
+        queues[dst] = xQueueCreateStatic(QUEUE_LEN, sizeof(task_msg_t), queue_storage[dst], &queue_buffers[dst]);
+    }
+    return queues[dst];
+}
+
+// like main.c, TIMEKEEP waits on its notification if the tick comes from the ISR
+static bool notified(task_type_t dst)
+{
+    return SECOND_TICK_ISR && dst == TASK_TIMEKEEP;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void MOCK_log_init(void)
+{
+    static StaticSemaphore_t buffer;
+    xUartSemaphore = xSemaphoreCreateMutexStatic(&buffer);
+}
+
+void serial_print_custom(void)
+{
+    static int verbose = -1;
+    if (verbose < 0)
+    {
+        const char* env = getenv("UNIT_VERBOSE");
+        verbose = (env != NULL && env[0] == '1');
+    }
+    if (verbose)
+    {
+        fputs(print_buf, stdout);
+    }
+}
+
+bool receiveTaskMessage(task_type_t dst, uint32_t timeout, task_msg_t *msg)
+{
+    QueueHandle_t handle = queue(dst);
+    return handle != NULL && xQueueReceive(handle, msg, timeout) == pdTRUE;
+}
+
+bool sendTaskMessage(task_msg_t *msg)
+{
+    QueueHandle_t handle = queue(msg->dst);
+    if (handle == NULL || xQueueSend(handle, msg, 0) != pdTRUE)
+    {
+        PRINT_LOG("Queue send failed, dst: %u, cmd: %u", msg->dst, msg->cmd);
+        return false;
+    }
+    if (notified(msg->dst))
+    {
+        xTaskNotify(NULL, TASK_NOTIFY_MSG, eSetBits);
+    }
+    return true;
+}
+
+bool sendTaskMessageISR(task_msg_t *msg)
+{
+    sendTaskMessage(msg);
+    return false;
+}
+
+bool notifyTaskISR(task_type_t dst, uint32_t bits)
+{
+    if (notified(dst))
+    {
+        xTaskNotifyFromISR(NULL, bits, eSetBits, NULL);
+    }
+    return false;
+}
+
+esp_err_t store_ram_mirror(void)
+{
+    return ESP_OK;
+}
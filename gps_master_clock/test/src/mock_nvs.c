@@ -0,0 +1,161 @@
+#include <string.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_rom_crc.h"
+
+#include "mock.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define MAX_KEYS        8
+#define MAX_KEY_LEN     15 // NVS_KEY_NAME_MAX_SIZE - 1
+#define MAX_BLOB_LEN    512
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+typedef struct
+{
+    char key[MAX_KEY_LEN + 1];
+    uint8_t data[MAX_BLOB_LEN];
+    size_t len;
+} nvs_entry_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static nvs_entry_t entries[MAX_KEYS];
+static uint8_t num_entries;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static nvs_entry_t* find(const char* key)
+{
+    for (uint8_t idx = 0; idx < num_entries; idx++)
+    {
+        if (strcmp(entries[idx].key, key) == 0)
+            return &entries[idx];
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void MOCK_NVS_reset(void)
+{
+    num_entries = 0;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+    }
+    return ~crc;
+}
+
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t* buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xE0 : 0);
+        }
+    }
+    return ~crc;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    MOCK_NVS_reset();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    (void)name;
+    (void)open_mode;
+    *out_handle = 1; // a single namespace
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length)
+{
+    (void)handle;
+    nvs_entry_t* entry = find(key);
+    if (entry == NULL)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    if (out_value != NULL)
+    {
+        if (*length < entry->len)
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        memcpy(out_value, entry->data, entry->len);
+    }
+    *length = entry->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length)
+{
+    (void)handle;
+    nvs_entry_t* entry = find(key);
+    if (strlen(key) > MAX_KEY_LEN || length > MAX_BLOB_LEN)
+        return ESP_ERR_INVALID_ARG;
+
+    if (entry == NULL)
+    {
+        if (num_entries >= MAX_KEYS)
+            return ESP_ERR_NVS_NO_FREE_PAGES;
+        entry = &entries[num_entries++];
+        strcpy(entry->key, key);
+    }
+    memcpy(entry->data, value, length);
+    entry->len = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    (void)handle;
+    nvs_entry_t* entry = find(key);
+    if (entry == NULL)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    *entry = entries[--num_entries];
+    return ESP_OK;
+}
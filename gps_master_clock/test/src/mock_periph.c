@@ -0,0 +1,148 @@
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "driver/uart.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_system.h"
+#include "esp_rtc_time.h"
+#include "esp_timer.h"
+
+#include "mock.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define NUM_GPIOS       40
+#define LOG_LEN         1024 // gpio_set_level() calls, the oldest are dropped
+#define UART_RX_LEN     4096
+#define UART_BYTE_US    1042 // 10 bits at 9600 baud
+#define CPU_MHZ         240
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static uint8_t levels[NUM_GPIOS];
+static mock_gpio_level_t gpio_log[LOG_LEN];
+static size_t log_cnt;
+
+static char uart_rx[UART_RX_LEN];
+static size_t rx_head;
+static size_t rx_len;
+
+static esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+static int64_t rtc_offset_us;
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+void MOCK_GPIO_reset(void)
+{
+    memset(levels, 0, sizeof(levels));
+    log_cnt = 0;
+}
+
+const mock_gpio_level_t* MOCK_GPIO_log(size_t* cnt)
+{
+    *cnt = (log_cnt < LOG_LEN) ? log_cnt : LOG_LEN;
+    return gpio_log;
+}
+
+void MOCK_UART_receive(const char* data)
+{
+    size_t len = strlen(data);
+    if (rx_head + rx_len + len > UART_RX_LEN)
+    { // move the unread rest to the front
+        memmove(uart_rx, uart_rx + rx_head, rx_len);
+        rx_head = 0;
+    }
+    if (rx_len + len > UART_RX_LEN)
+        len = UART_RX_LEN - rx_len;
+    memcpy(uart_rx + rx_head + rx_len, data, len);
+    rx_len += len;
+}
+
+void MOCK_set_reset_reason(esp_reset_reason_t reason, int64_t rtc_us)
+{
+    reset_reason = reason;
+    rtc_offset_us = rtc_us - esp_timer_get_time();
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    (void)mode;
+    return (gpio_num >= 0 && gpio_num < NUM_GPIOS) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= NUM_GPIOS)
+        return ESP_ERR_INVALID_ARG;
+
+    levels[gpio_num] = (level != 0);
+    gpio_log[log_cnt++ % LOG_LEN] = (mock_gpio_level_t){ .gpio = gpio_num, .level = levels[gpio_num],
+        .us = esp_timer_get_time() };
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return (gpio_num >= 0 && gpio_num < NUM_GPIOS) ? levels[gpio_num] : 0;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+    QueueHandle_t* uart_queue, int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t* uart_config)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num)
+{
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void* buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    if (rx_len == 0)
+        MOCK_end_task(); // all received, the task under test is done
+
+    uint32_t len = (length < rx_len) ? length : rx_len;
+    memcpy(buf, uart_rx + rx_head, len);
+    rx_head += len;
+    rx_len -= len;
+    MOCK_advance_us((int64_t)len * UART_BYTE_US);
+    return len;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void* src, size_t size)
+{
+    return size;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    return (esp_cpu_cycle_count_t)(esp_timer_get_time() * CPU_MHZ);
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return CPU_MHZ;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return reset_reason;
+}
+
+uint64_t esp_rtc_get_time_us(void)
+{
+    return esp_timer_get_time() + rtc_offset_us;
+}
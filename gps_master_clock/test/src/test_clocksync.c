@@ -0,0 +1,176 @@
+#include "unit.h"
+#include "clocksync.h"
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static int hm(int hours, int minutes)
+{
+    return hours * 60 + minutes;
+}
+
+static void test_in_sync(void)
+{
+    int minutes = -1;
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(3, 15), hm(15, 15), false, &minutes), CLOCKSYNC_IN_SYNC);
+    CHECK_EQ(minutes, 0);
+    CHECK_EQ(CLOCKSYNC_minute_sync(0, hm(0, 0), true, &minutes), CLOCKSYNC_IN_SYNC);
+}
+
+static void test_noon_crossing(void)
+{
+    int minutes = 0;
+    // face 11:59, the time turns 12:00 or 00:00: one pulse, also on provisional time
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(11, 59), hm(12, 0), true, &minutes), CLOCKSYNC_ADVANCE);
+    CHECK_EQ(minutes, 1);
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(11, 59), hm(0, 0), false, &minutes), CLOCKSYNC_ADVANCE);
+    CHECK_EQ(minutes, 1);
+    // a few minutes behind across 12 o'clock
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(11, 57), hm(12, 2), true, &minutes), CLOCKSYNC_ADVANCE);
+    CHECK_EQ(minutes, 5);
+}
+
+static void test_lead(void)
+{
+    int minutes = 0;
+    // face already past 12 o'clock, the time is not: short lead, wait
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(0, 2), hm(23, 58), false, &minutes), CLOCKSYNC_WAIT_LEAD);
+    CHECK_EQ(minutes, 4);
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(4, 5), hm(4, 0), false, &minutes), CLOCKSYNC_WAIT_LEAD);
+    CHECK_EQ(minutes, MAX_LOCAL_CLOCK_LEAD_MINUTES);
+
+    // one minute more than allowed: wrap around onto the target, or wait for GPS on provisional time
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(4, 6), hm(4, 0), false, &minutes), CLOCKSYNC_WRAP_AROUND);
+    CHECK_EQ(minutes, MINUTES_PER_12H - 6);
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(4, 6), hm(4, 0), true, &minutes), CLOCKSYNC_WAIT_PROVISIONAL);
+    CHECK_EQ(minutes, 6);
+}
+
+static void test_half_dial(void)
+{
+    int minutes = 0;
+    // exactly opposite counts as behind, just past it as ahead
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(1, 0), hm(7, 0), true, &minutes), CLOCKSYNC_ADVANCE);
+    CHECK_EQ(minutes, 360);
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(1, 0), hm(7, 1), false, &minutes), CLOCKSYNC_WRAP_AROUND);
+    CHECK_EQ(minutes, 361);
+    CHECK_EQ(CLOCKSYNC_minute_sync(hm(1, 0), hm(7, 1), true, &minutes), CLOCKSYNC_WAIT_PROVISIONAL);
+    CHECK_EQ(minutes, 359);
+}
+
+static void test_all_positions(void)
+{
+    // every face position against every time of the day: pulses always end up on the target,
+    // waiting only ever happens for a real lead
+    for (int face = 0; face < MINUTES_PER_12H; face++)
+    {
+        for (int target = 0; target < 24 * 60; target++)
+        {
+            for (int provisional = 0; provisional < 2; provisional++)
+            {
+                int minutes = -1;
+                clocksync_action_t action = CLOCKSYNC_minute_sync(face, target, provisional, &minutes);
+                int dial_target = target % MINUTES_PER_12H;
+
+                switch (action)
+                {
+                case CLOCKSYNC_IN_SYNC:
+                    CHECK_EQ(face, dial_target);
+                    break;
+                case CLOCKSYNC_ADVANCE:
+                    CHECK(minutes > 0 && minutes <= MINUTES_PER_12H / 2);
+                    CHECK_EQ((face + minutes) % MINUTES_PER_12H, dial_target);
+                    break;
+                case CLOCKSYNC_WRAP_AROUND:
+                    CHECK(!provisional);
+                    CHECK(minutes > MINUTES_PER_12H / 2 && minutes < MINUTES_PER_12H - MAX_LOCAL_CLOCK_LEAD_MINUTES);
+                    CHECK_EQ((face + minutes) % MINUTES_PER_12H, dial_target);
+                    break;
+                case CLOCKSYNC_WAIT_LEAD:
+                    CHECK(minutes > 0 && minutes <= MAX_LOCAL_CLOCK_LEAD_MINUTES);
+                    CHECK_EQ((dial_target + minutes) % MINUTES_PER_12H, face);
+                    break;
+                case CLOCKSYNC_WAIT_PROVISIONAL:
+                    CHECK(provisional);
+                    CHECK(minutes > MAX_LOCAL_CLOCK_LEAD_MINUTES && minutes < MINUTES_PER_12H / 2);
+                    CHECK_EQ((dial_target + minutes) % MINUTES_PER_12H, face);
+                    break;
+                default:
+                    CHECK(0);
+                }
+            }
+        }
+    }
+}
+
+static void test_minute_crossed(void)
+{
+    const time_t minute = 1760000000 / 60 * 60; // some full minute
+
+    CHECK(CLOCKSYNC_minute_crossed(minute - 1, minute));
+    CHECK(!CLOCKSYNC_minute_crossed(minute, minute + 1));
+    CHECK(!CLOCKSYNC_minute_crossed(minute + 1, minute + 59));
+    // the tick of second 0 was missed, or the time was set forward across it
+    CHECK(CLOCKSYNC_minute_crossed(minute - 1, minute + 1));
+    CHECK(CLOCKSYNC_minute_crossed(minute - 30, minute + 90));
+    // first tick, or the time was set back: only a full minute itself
+    CHECK(CLOCKSYNC_minute_crossed(0, minute));
+    CHECK(!CLOCKSYNC_minute_crossed(0, minute + 1));
+    CHECK(!CLOCKSYNC_minute_crossed(minute + 3, minute + 1));
+    CHECK(CLOCKSYNC_minute_crossed(minute + 3, minute));
+}
+
+static void test_drift_correction(void)
+{
+    uint32_t pos = 0, neg = 0;
+    CHECK(!CLOCKSYNC_drift_correction(MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS, false, &pos, &neg));
+    CHECK(!CLOCKSYNC_drift_correction(-MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS, false, &pos, &neg));
+    CHECK(CLOCKSYNC_drift_correction(3, false, &pos, &neg));
+    CHECK(CLOCKSYNC_drift_correction(-4, false, &pos, &neg));
+    CHECK_EQ(pos, 3);
+    CHECK_EQ(neg, 4);
+
+    // the error of a provisional estimate is set, but not counted as drift
+    CHECK(CLOCKSYNC_drift_correction(3600, true, &pos, &neg));
+    CHECK_EQ(pos, 3);
+    CHECK_EQ(neg, 4);
+}
+
+static void test_anchor(void)
+{
+    const time_t anchor = 1760000000;
+    const uint64_t anchor_rtc_us = 5000000000ULL;
+    time_t utc = 0;
+
+    // rounded to the nearest full second
+    CHECK(CLOCKSYNC_anchor_utc(anchor, anchor_rtc_us, anchor_rtc_us + 2499999, &utc));
+    CHECK_EQ(utc, anchor + 2);
+    CHECK(CLOCKSYNC_anchor_utc(anchor, anchor_rtc_us, anchor_rtc_us + 2500000, &utc));
+    CHECK_EQ(utc, anchor + 3);
+    CHECK(CLOCKSYNC_anchor_utc(anchor, anchor_rtc_us, anchor_rtc_us + MAX_ANCHOR_AGE_S * 1000000ULL, &utc));
+    CHECK_EQ(utc, anchor + MAX_ANCHOR_AGE_S);
+
+    // too old for the RC oscillator, or the RTC timer was reset (power loss)
+    utc = 0;
+    CHECK(!CLOCKSYNC_anchor_utc(anchor, anchor_rtc_us, anchor_rtc_us + (MAX_ANCHOR_AGE_S + 1) * 1000000ULL, &utc));
+    CHECK(!CLOCKSYNC_anchor_utc(anchor, anchor_rtc_us, 1000000, &utc));
+    CHECK_EQ(utc, 0);
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_in_sync);
+    RUN(test_noon_crossing);
+    RUN(test_lead);
+    RUN(test_half_dial);
+    RUN(test_all_positions);
+    RUN(test_minute_crossed);
+    RUN(test_drift_correction);
+    RUN(test_anchor);
+    return UNIT_RESULT();
+}
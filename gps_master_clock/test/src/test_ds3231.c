@@ -0,0 +1,208 @@
+#include <string.h>
+
+#include "unit.h"
+#include "mock.h"
+#include "ds3231.h"
+#include "i2c_bus.h"
+#include "bsp.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define NUM_REGS        0x13 // seconds up to the temperature registers
+
+#define REG_SECONDS     0x00
+#define REG_HOURS       0x02
+#define REG_DAY         0x03
+#define REG_MONTH       0x05
+#define REG_YEAR        0x06
+#define REG_STATUS      0x0F
+
+#define STATUS_OSF      0x80
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+typedef struct
+{
+    uint8_t regs[NUM_REGS];
+    uint8_t ptr; // register pointer, auto incremented by every byte read or written
+} ds3231_model_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static ds3231_model_t rtc;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// datasheet "I2C serial data bus": the first written byte sets the pointer, the others are stored from there on
+static esp_err_t ds3231_xfer(mock_i2c_device_t* dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len)
+{
+    ds3231_model_t* model = dev->ctx;
+
+    for (size_t idx = 0; idx < tx_len; idx++)
+    {
+        if (idx == 0)
+        {
+            model->ptr = tx[0] % NUM_REGS;
+        }
+        else
+        {
+            model->regs[model->ptr] = tx[idx];
+            model->ptr = (model->ptr + 1) % NUM_REGS;
+        }
+    }
+
+    for (size_t idx = 0; idx < rx_len; idx++)
+    {
+        rx[idx] = model->regs[model->ptr];
+        model->ptr = (model->ptr + 1) % NUM_REGS;
+    }
+    return ESP_OK;
+}
+
+static mock_i2c_device_t ds3231 = { .addr = DS3231_ADDR, .xfer = ds3231_xfer, .ctx = &rtc };
+
+// the bus manager task, runs while the driver waits
+static bool run_bus(void)
+{
+    return I2C_BUS_process(0);
+}
+
+static void set_regs(uint8_t sec, uint8_t min, uint8_t hour, uint8_t date, uint8_t month, uint8_t year)
+{
+    const uint8_t regs[] = { sec, min, hour, 1, date, month, year };
+    memcpy(rtc.regs, regs, sizeof(regs));
+}
+
+static void check_read(time_t expected)
+{
+    time_t utc = 0;
+    CHECK_EQ(DS3231_read_utc(&utc), ESP_OK);
+    CHECK_EQ(utc, expected);
+}
+
+static void test_absent(void)
+{
+    time_t utc = 0;
+
+    MOCK_log_init();
+    MOCK_set_blocked_hook(run_bus);
+    CHECK_EQ(I2C_BUS_init(), ESP_OK);
+
+    // nothing on the bus: every call fails without touching the bus, the clock runs without RTC
+    CHECK_EQ(DS3231_init(), ESP_ERR_NOT_FOUND);
+    CHECK(!DS3231_present());
+    CHECK_EQ(DS3231_read_utc(&utc), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(DS3231_write_utc(1700000000), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(utc, 0);
+}
+
+static void test_oscillator_stopped(void)
+{
+    time_t utc = 0;
+
+    // power on with an empty battery: OSF is set, the registers hold garbage
+    memset(rtc.regs, 0, sizeof(rtc.regs));
+    rtc.regs[REG_STATUS] = STATUS_OSF;
+    MOCK_I2C_attach(&ds3231);
+    CHECK_EQ(DS3231_init(), ESP_OK);
+    CHECK(DS3231_present());
+    CHECK_EQ(DS3231_read_utc(&utc), ESP_ERR_INVALID_STATE);
+
+    // setting the time clears the flag
+    CHECK_EQ(DS3231_write_utc(1700000000), ESP_OK); // 2023-11-14 22:13:20 UTC, Tuesday
+    CHECK_EQ(rtc.regs[REG_STATUS] & STATUS_OSF, 0);
+    check_read(1700000000);
+}
+
+static void test_bcd_registers(void)
+{
+    // 2024-02-29 23:59:59 UTC, Thursday
+    CHECK_EQ(DS3231_write_utc(1709251199), ESP_OK);
+    const uint8_t expected[] = { 0x59, 0x59, 0x23, 5, 0x29, 0x02, 0x24 };
+    CHECK(memcmp(rtc.regs, expected, sizeof(expected)) == 0);
+    check_read(1709251199);
+
+    // registers as the RTC counts them up one second later
+    set_regs(0x00, 0x00, 0x00, 0x01, 0x03, 0x24);
+    check_read(1709251200);
+}
+
+static void test_century(void)
+{
+    // 2099-12-31 23:59:59 -> 2100-01-01 00:00:00: year register wraps, century bit set
+    CHECK_EQ(DS3231_write_utc(4102444799), ESP_OK);
+    CHECK_EQ(rtc.regs[REG_MONTH], 0x12);
+    CHECK_EQ(rtc.regs[REG_YEAR], 0x99);
+    check_read(4102444799);
+
+    CHECK_EQ(DS3231_write_utc(4102444800), ESP_OK);
+    CHECK_EQ(rtc.regs[REG_MONTH], 0x81);
+    CHECK_EQ(rtc.regs[REG_YEAR], 0x00);
+    check_read(4102444800);
+
+    // 2000-01-01 is the first, 2199-12-31 the last representable day
+    CHECK_EQ(DS3231_write_utc(946684800), ESP_OK);
+    check_read(946684800);
+    CHECK_EQ(DS3231_write_utc(7258118399), ESP_OK);
+    check_read(7258118399);
+
+    // out of range, the registers stay untouched
+    CHECK_EQ(DS3231_write_utc(946684799), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(DS3231_write_utc(7258118400), ESP_ERR_INVALID_ARG);
+    check_read(7258118399);
+}
+
+static void test_12h_mode(void)
+{
+    // not written by the driver, e.g. set by another device: bit 6 12h, bit 5 PM, 12 is midnight/noon
+    set_regs(0x00, 0x30, 0x40 | 0x12, 0x01, 0x01, 0x24); // 12:30 AM
+    check_read(1704069000);                             // 2024-01-01 00:30:00
+    set_regs(0x00, 0x30, 0x40 | 0x11, 0x01, 0x01, 0x24); // 11:30 AM
+    check_read(1704069000 + 11 * 3600);
+    set_regs(0x00, 0x30, 0x60 | 0x12, 0x01, 0x01, 0x24); // 12:30 PM
+    check_read(1704069000 + 12 * 3600);
+    set_regs(0x00, 0x30, 0x60 | 0x01, 0x01, 0x01, 0x24); // 1:30 PM
+    check_read(1704069000 + 13 * 3600);
+    set_regs(0x00, 0x30, 0x60 | 0x11, 0x01, 0x01, 0x24); // 11:30 PM
+    check_read(1704069000 + 23 * 3600);
+
+    // writing switches back to 24h mode
+    CHECK_EQ(DS3231_write_utc(1704069000 + 23 * 3600), ESP_OK);
+    CHECK_EQ(rtc.regs[REG_HOURS], 0x23);
+}
+
+static void test_bus_error(void)
+{
+    time_t utc = 0;
+
+    // the RTC holds the clock low for too long: the error is passed on, the time stays untouched
+    ds3231.stretch_us = 2 * I2C_BUS_MAX_TRANSACTION_MS * 1000;
+    CHECK(DS3231_read_utc(&utc) != ESP_OK);
+    CHECK(DS3231_write_utc(1700000000) != ESP_OK);
+    CHECK_EQ(utc, 0);
+    ds3231.stretch_us = 0;
+    check_read(1704069000 + 23 * 3600);
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_absent);
+    RUN(test_oscillator_stopped);
+    RUN(test_bcd_registers);
+    RUN(test_century);
+    RUN(test_12h_mode);
+    RUN(test_bus_error);
+    return UNIT_RESULT();
+}
@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "unit.h"
+#include "mock.h"
+#include "i2c_bus.h"
+#include "bsp.h"
+#include "esp_timer.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define ROW_BYTES 84 // a full LCD row with the cursor command
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static uint8_t rtc_regs[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+static esp_err_t rtc_xfer(mock_i2c_device_t* dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len)
+{
+    (void)dev;
+    if (tx_len == 1 && rx_len <= sizeof(rtc_regs) - tx[0])
+    {
+        memcpy(rx, &rtc_regs[tx[0]], rx_len);
+    }
+    return ESP_OK;
+}
+
+static mock_i2c_device_t lcd_model = { .addr = LCM1602_ADDR };
+static mock_i2c_device_t rtc_model = { .addr = DS3231_ADDR, .xfer = rtc_xfer };
+
+static i2c_bus_dev_handle_t lcd;
+static i2c_bus_dev_handle_t rtc;
+
+static uint32_t done_calls;
+static int64_t done_at_us;
+static esp_err_t done_result;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// the bus manager task, runs while the test waits
+static bool run_bus(void)
+{
+    return I2C_BUS_process(0);
+}
+
+static void on_done(void* arg, esp_err_t result, int64_t done_us)
+{
+    (*(uint32_t*)arg)++;
+    done_at_us = done_us;
+    done_result = result;
+}
+
+static void test_setup(void)
+{
+    MOCK_log_init();
+    MOCK_set_blocked_hook(run_bus);
+    MOCK_I2C_attach(&lcd_model);
+    MOCK_I2C_attach(&rtc_model);
+
+    CHECK_EQ(I2C_BUS_init(), ESP_OK);
+    CHECK_EQ(I2C_BUS_add_device(LCM1602_ADDR, I2C_BUS_PRIO_LOW, "LCD", &lcd), ESP_OK);
+    CHECK_EQ(I2C_BUS_add_device(DS3231_ADDR, I2C_BUS_PRIO_HIGH, "RTC", &rtc), ESP_OK);
+    CHECK_EQ(I2C_BUS_probe(LCM1602_ADDR), ESP_OK);
+    CHECK_EQ(I2C_BUS_probe(0x50), ESP_ERR_NOT_FOUND);
+    I2C_BUS_set_done_cb(lcd, on_done, &done_calls);
+}
+
+static void test_priority(void)
+{
+    static uint8_t row[ROW_BYTES];
+    uint8_t reg = 1;
+    uint8_t rx[2] = { 0 };
+    size_t before, cnt;
+    MOCK_I2C_log(&before);
+
+    // both pending: the RTC goes first, although the display was queued first
+    CHECK_EQ(I2C_BUS_submit(lcd, row, sizeof(row), NULL, 0), ESP_OK);
+    CHECK_EQ(I2C_BUS_submit(rtc, &reg, 1, rx, sizeof(rx)), ESP_OK);
+    CHECK(I2C_BUS_process(0));
+    CHECK(I2C_BUS_process(0));
+    CHECK(!I2C_BUS_process(0)); // nothing left
+
+    const mock_i2c_xfer_t* log = MOCK_I2C_log(&cnt);
+    CHECK_EQ(cnt, before + 2);
+    CHECK_EQ(log[before].addr, DS3231_ADDR);
+    CHECK_EQ(log[before + 1].addr, LCM1602_ADDR);
+    CHECK(log[before + 1].start_us >= log[before].end_us);
+
+    CHECK_EQ(I2C_BUS_wait(rtc, 0), ESP_OK);
+    CHECK_EQ(rx[0], 0x34);
+    CHECK_EQ(rx[1], 0x56);
+    CHECK_EQ(I2C_BUS_wait(lcd, 0), ESP_OK);
+}
+
+static void test_row_timing(void)
+{
+    static uint8_t row[ROW_BYTES];
+    uint32_t calls = done_calls;
+
+    // a full row takes (84 + 1) * 9 clocks at 100kHz = 7.65ms, with some clock stretching it is still fine
+    lcd_model.stretch_us = 4000;
+    int64_t start_us = esp_timer_get_time();
+    CHECK_EQ(I2C_BUS_transfer(lcd, row, sizeof(row), NULL, 0, 50), ESP_OK);
+    CHECK_EQ(done_calls, calls + 1);
+    CHECK_EQ(done_result, ESP_OK);
+    CHECK_EQ(done_at_us - start_us, (ROW_BYTES + 1) * 9 * 1000000LL / I2C_FREQ_HZ + 4000);
+
+    // a device which holds the clock low for long: the transaction times out, the bus is free again
+    lcd_model.stretch_us = 100000;
+    CHECK_EQ(I2C_BUS_transfer(lcd, row, sizeof(row), NULL, 0, 100), ESP_ERR_TIMEOUT);
+    CHECK_EQ(done_result, ESP_ERR_TIMEOUT);
+    CHECK(done_at_us - start_us < 100000);
+    lcd_model.stretch_us = 0;
+    CHECK_EQ(I2C_BUS_transfer(lcd, row, 4, NULL, 0, 50), ESP_OK);
+}
+
+static void test_one_in_flight(void)
+{
+    static uint8_t a[8], b[8];
+    size_t before, cnt;
+    MOCK_I2C_log(&before);
+
+    // the second submit of a device waits (here: runs the bus manager) until the first is done
+    CHECK_EQ(I2C_BUS_submit(lcd, a, sizeof(a), NULL, 0), ESP_OK);
+    CHECK_EQ(I2C_BUS_submit(lcd, b, sizeof(b), NULL, 0), ESP_OK);
+    MOCK_I2C_log(&cnt);
+    CHECK_EQ(cnt, before + 1);
+    CHECK_EQ(I2C_BUS_wait(lcd, 50), ESP_OK);
+    MOCK_I2C_log(&cnt);
+    CHECK_EQ(cnt, before + 2);
+}
+
+static void test_timeout_without_bus_manager(void)
+{
+    static uint8_t a[8];
+
+    MOCK_set_blocked_hook(NULL); // I2C_BUS_Task starved
+    CHECK_EQ(I2C_BUS_submit(lcd, a, sizeof(a), NULL, 0), ESP_OK);
+    int64_t start_us = esp_timer_get_time();
+    CHECK_EQ(I2C_BUS_wait(lcd, 20), ESP_ERR_TIMEOUT);
+    CHECK_EQ(esp_timer_get_time() - start_us, 20000);
+    CHECK_EQ(I2C_BUS_submit(lcd, a, sizeof(a), NULL, 0), ESP_ERR_TIMEOUT);
+
+    MOCK_set_blocked_hook(run_bus);
+    CHECK_EQ(I2C_BUS_wait(lcd, 20), ESP_OK);
+    I2C_BUS_print_stats();
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_setup);
+    RUN(test_priority);
+    RUN(test_row_timing);
+    RUN(test_one_in_flight);
+    RUN(test_timeout_without_bus_manager);
+    return UNIT_RESULT();
+}
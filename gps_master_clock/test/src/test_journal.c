@@ -0,0 +1,203 @@
+#include "unit.h"
+#include "mock.h"
+#include "journal.h"
+#include "clocksync.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define NUM_SECTORS         16                  // 64kB partition
+#define ENTRIES_PER_SECTOR  ((4096 - 16) / 4)   // after the sector header
+
+// flash operations of a record which starts a new sector
+#define OP_ERASE            0
+#define OP_HEADER           1
+#define OP_ENTRY            2
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static int position; // what the hands show, advanced by record()
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static esp_err_t record(void)
+{
+    position = (position + 1) % MINUTES_PER_12H;
+    return JOURNAL_record_position(position);
+}
+
+static void record_n(uint32_t cnt)
+{
+    for (uint32_t idx = 0; idx < cnt; idx++)
+    {
+        CHECK_EQ(record(), ESP_OK);
+    }
+}
+
+// power on after a loss: the journal is all there is
+static void reboot(esp_err_t expected_err, int expected_position)
+{
+    int restored = -1;
+    MOCK_FLASH_power_on();
+    CHECK_EQ(JOURNAL_init(&restored), expected_err);
+    if (expected_err == ESP_OK)
+    {
+        CHECK_EQ(restored, expected_position);
+    }
+}
+
+// an empty journal whose first sector was just filled, the next record starts a new sector
+static void fill_first_sector(void)
+{
+    int unused;
+    MOCK_FLASH_reset();
+    CHECK_EQ(JOURNAL_init(&unused), ESP_ERR_NOT_FOUND);
+    position = 0;
+    record_n(ENTRIES_PER_SECTOR);
+}
+
+static void test_empty(void)
+{
+    MOCK_log_init();
+    MOCK_FLASH_reset();
+
+    CHECK_EQ(JOURNAL_record_position(5), ESP_ERR_INVALID_STATE); // not initialized yet
+    reboot(ESP_ERR_NOT_FOUND, 0);
+    position = 4;
+    record_n(1);
+    reboot(ESP_OK, 5);
+
+    // the same position is not written again
+    CHECK_EQ(JOURNAL_record_position(5), ESP_OK);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 0), 1);
+    reboot(ESP_OK, 5);
+}
+
+static void test_rotation(void)
+{
+    fill_first_sector();
+    reboot(ESP_OK, ENTRIES_PER_SECTOR % MINUTES_PER_12H);
+
+    record_n(1);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 1), 1);
+    reboot(ESP_OK, position);
+
+    // appends after what is already in the sector
+    record_n(10);
+    reboot(ESP_OK, position);
+    record_n(ENTRIES_PER_SECTOR - 11);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 2), 0);
+    record_n(1);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 2), 1);
+    reboot(ESP_OK, position);
+}
+
+static void test_wrap_around(void)
+{
+    // three times around the ring: every sector is erased equally often, the newest one wins
+    fill_first_sector();
+    record_n(3 * NUM_SECTORS * ENTRIES_PER_SECTOR - ENTRIES_PER_SECTOR);
+    for (uint32_t sector = 0; sector < NUM_SECTORS; sector++)
+    {
+        CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, sector), 3);
+    }
+    reboot(ESP_OK, position);
+    record_n(1);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 0), 4);
+    reboot(ESP_OK, position);
+}
+
+static void test_cut_erase(void)
+{
+    // power lost while erasing the next sector, half of it is erased
+    fill_first_sector();
+    int saved = position;
+    MOCK_FLASH_cut_after(OP_ERASE, 2048);
+    CHECK(record() != ESP_OK);
+    reboot(ESP_OK, saved);
+
+    // the rotation is done again
+    record_n(1);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 1), 2);
+    reboot(ESP_OK, position);
+}
+
+static void test_cut_header(void)
+{
+    // the new header is torn: magic and sequence number, but not its complement
+    fill_first_sector();
+    int saved = position;
+    MOCK_FLASH_cut_after(OP_HEADER, 8);
+    CHECK(record() != ESP_OK);
+    reboot(ESP_OK, saved);
+    record_n(1);
+    reboot(ESP_OK, position);
+
+    // only the magic
+    fill_first_sector();
+    saved = position;
+    MOCK_FLASH_cut_after(OP_HEADER, 4);
+    CHECK(record() != ESP_OK);
+    reboot(ESP_OK, saved);
+    record_n(2);
+    reboot(ESP_OK, position);
+}
+
+static void test_cut_first_entry(void)
+{
+    // the new sector is started, but its first entry was never written: the previous sector has the position
+    fill_first_sector();
+    int saved = position;
+    MOCK_FLASH_cut_after(OP_ENTRY, 0);
+    CHECK(record() != ESP_OK);
+    reboot(ESP_OK, saved);
+
+    // the new sector is used, no second rotation
+    record_n(1);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 1), 1);
+    CHECK_EQ(MOCK_FLASH_erase_count(JOURNAL_PARTITION_LABEL, 2), 0);
+    reboot(ESP_OK, position);
+
+    // the first entry is torn: its CRC does not match, the previous sector has the position
+    fill_first_sector();
+    saved = position;
+    MOCK_FLASH_cut_after(OP_ENTRY, 2);
+    CHECK(record() != ESP_OK);
+    reboot(ESP_OK, saved);
+    record_n(1);
+    reboot(ESP_OK, position);
+}
+
+static void test_cut_entry(void)
+{
+    // a torn entry in the middle of a sector is skipped, the next one goes after it
+    fill_first_sector();
+    record_n(5);
+    int saved = position;
+    MOCK_FLASH_cut_after(0, 1);
+    CHECK(record() != ESP_OK);
+    reboot(ESP_OK, saved);
+    record_n(1);
+    reboot(ESP_OK, position);
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_empty);
+    RUN(test_rotation);
+    RUN(test_wrap_around);
+    RUN(test_cut_erase);
+    RUN(test_cut_header);
+    RUN(test_cut_first_entry);
+    RUN(test_cut_entry);
+    return UNIT_RESULT();
+}
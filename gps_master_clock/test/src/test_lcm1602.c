@@ -0,0 +1,432 @@
+#include <string.h>
+
+#include "unit.h"
+#include "mock.h"
+#include "LCM1602.h"
+#include "i2c_bus.h"
+#include "bsp.h"
+#include "esp_timer.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define STREAM_LEN      4096
+#define BYTE_US         (9 * 1000000 / I2C_FREQ_HZ) // one byte with ACK on the bus
+
+// HD44780 timing, datasheet table 6 and figure 24 (fosc = 270kHz)
+#define POWER_ON_US     40000
+#define INIT_FIRST_US   4100
+#define INIT_NEXT_US    100
+#define CLEAR_HOME_US   1520
+#define EXEC_US         37
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+// HD44780 behind the PCF8574, as far as the driver uses it
+typedef struct
+{
+    bool four_bit;
+    bool high_nibble_done;
+    uint8_t high_nibble;
+    bool high_rs;
+    uint8_t init_writes;    // instructions received in 8 bit mode
+    uint8_t prev;           // last PCF8574 output, the HD44780 latches on the falling edge of EN
+    int64_t busy_until_us;
+    uint32_t busy_violations;
+    bool cgram;             // address counter points into CGRAM
+    uint8_t ac;
+    uint8_t function;
+    uint8_t control;
+    uint8_t entry;
+    char ddram[128];
+    uint8_t cgram_data[64];
+    int64_t first_latch_us;
+} hd44780_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static hd44780_t lcd;
+
+// everything the PCF8574 received
+static uint8_t stream[STREAM_LEN];
+static size_t stream_len;
+
+// transfers to fail with a NACK, nothing reaches the display
+static uint32_t fail_cnt;
+
+// what the old driver sent, one i2c_master_transmit per byte
+static uint8_t ref[STREAM_LEN];
+static size_t ref_len;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static void hd44780_execute(hd44780_t* hd, bool rs, uint8_t value, int64_t now_us)
+{
+    uint32_t exec_us = EXEC_US;
+
+    if (rs)
+    {
+        if (hd->cgram)
+            hd->cgram_data[hd->ac & 0x3F] = value;
+        else
+            hd->ddram[hd->ac & 0x7F] = value;
+        hd->ac += (hd->entry & LCD_ENTRYLEFT) ? 1 : -1;
+    }
+    else if (value & LCD_SETDDRAMADDR)
+    {
+        hd->ac = value & 0x7F;
+        hd->cgram = false;
+    }
+    else if (value & LCD_SETCGRAMADDR)
+    {
+        hd->ac = value & 0x3F;
+        hd->cgram = true;
+    }
+    else if (value & LCD_FUNCTIONSET)
+    {
+        hd->function = value;
+    }
+    else if (value & LCD_CURSORSHIFT)
+    {
+        // not modelled
+    }
+    else if (value & LCD_DISPLAYCONTROL)
+    {
+        hd->control = value;
+    }
+    else if (value & LCD_ENTRYMODESET)
+    {
+        hd->entry = value;
+    }
+    else if (value & LCD_RETURNHOME)
+    {
+        hd->ac = 0;
+        hd->cgram = false;
+        exec_us = CLEAR_HOME_US;
+    }
+    else if (value & LCD_CLEARDISPLAY)
+    {
+        memset(hd->ddram, ' ', sizeof(hd->ddram));
+        hd->ac = 0;
+        hd->cgram = false;
+        hd->entry |= LCD_ENTRYLEFT;
+        exec_us = CLEAR_HOME_US;
+    }
+
+    hd->busy_until_us = now_us + exec_us;
+}
+
+// one falling edge of EN
+static void hd44780_latch(hd44780_t* hd, bool rs, uint8_t nibble, int64_t now_us)
+{
+    if (hd->first_latch_us == 0)
+    {
+        hd->first_latch_us = now_us;
+    }
+    if (now_us < hd->busy_until_us)
+    {
+        hd->busy_violations++;
+    }
+
+    if (!hd->four_bit)
+    { // 8 bit interface, only D7-D4 are connected: every nibble is a complete instruction with D3-D0 = 0
+        hd->busy_until_us = now_us + (hd->init_writes++ == 0 ? INIT_FIRST_US : INIT_NEXT_US);
+        if ((nibble << 4) == LCD_FUNCTIONSET)
+        {
+            hd->four_bit = true; // DL = 0
+        }
+        return;
+    }
+
+    if (!hd->high_nibble_done)
+    {
+        hd->high_nibble = nibble;
+        hd->high_rs = rs;
+        hd->high_nibble_done = true;
+        hd->busy_until_us = 0; // the second nibble follows without waiting
+        return;
+    }
+
+    CHECK_EQ(rs, hd->high_rs);
+    hd->high_nibble_done = false;
+    hd44780_execute(hd, rs, (hd->high_nibble << 4) | nibble, now_us);
+}
+
+static esp_err_t pcf8574_xfer(mock_i2c_device_t* dev, const uint8_t* tx, size_t tx_len, uint8_t* rx, size_t rx_len)
+{
+    hd44780_t* hd = dev->ctx;
+    int64_t start_us = esp_timer_get_time();
+
+    if (fail_cnt > 0)
+    {
+        fail_cnt--;
+        return ESP_FAIL;
+    }
+
+    for (size_t idx = 0; idx < tx_len; idx++)
+    {
+        uint8_t data = tx[idx];
+        if (stream_len < STREAM_LEN)
+        {
+            stream[stream_len++] = data;
+        }
+
+        if ((hd->prev & PIN_EN) && !(data & PIN_EN))
+        { // output of byte idx is valid after the address and idx + 1 bytes
+            CHECK_EQ(data & ~PIN_EN, hd->prev & ~PIN_EN); // data must be stable around the edge
+            hd44780_latch(hd, data & PIN_RS, data >> 4, start_us + (idx + 2) * BYTE_US);
+        }
+        hd->prev = data;
+    }
+    return ESP_OK;
+}
+
+static mock_i2c_device_t pcf8574 = { .addr = LCM1602_ADDR, .xfer = pcf8574_xfer, .ctx = &lcd };
+
+// the old writeNibble(): EN high and EN low, each with its own i2c_master_transmit()
+static void ref_nibble(uint8_t value, uint8_t mode)
+{
+    uint8_t data = PIN_BL | ((mode == LCD_DATA) ? PIN_RS : 0) | ((value & 0x0F) << 4);
+    ref[ref_len++] = data | PIN_EN;
+    ref[ref_len++] = data & ~PIN_EN;
+}
+
+static void ref_send(uint8_t value, uint8_t mode)
+{
+    if (mode != FOUR_BITS)
+    {
+        ref_nibble(value >> 4, mode);
+    }
+    ref_nibble(value, mode);
+}
+
+static void ref_print(const char* str)
+{
+    while (*str)
+    {
+        ref_send(*str++, LCD_DATA);
+    }
+}
+
+// the bus manager task, runs while the driver waits
+static bool run_bus(void)
+{
+    return I2C_BUS_process(0);
+}
+
+// lets the bus manager send what the driver queued last
+static void drain(void)
+{
+    while (I2C_BUS_process(0))
+    {
+    }
+}
+
+static void check_stream(void)
+{
+    CHECK_EQ(stream_len, ref_len);
+    CHECK(memcmp(stream, ref, ref_len) == 0);
+}
+
+static void check_row(uint8_t ddram_addr, const char* expected)
+{
+    CHECK(memcmp(&lcd.ddram[ddram_addr], expected, strlen(expected)) == 0);
+}
+
+static void test_begin(void)
+{
+    size_t log_start, log_end;
+
+    MOCK_log_init();
+    MOCK_set_blocked_hook(run_bus);
+    MOCK_I2C_attach(&pcf8574);
+    memset(lcd.ddram, '?', sizeof(lcd.ddram)); // undefined after power on
+    CHECK_EQ(I2C_BUS_init(), ESP_OK);
+
+    int64_t start_us = esp_timer_get_time();
+    MOCK_I2C_log(&log_start);
+    CHECK_EQ(LCD_I2C_begin(16, 2), ESP_OK);
+    drain();
+    MOCK_I2C_log(&log_end);
+
+    // same bytes as the old driver, datasheet figure 24
+    ref_send(0x03, FOUR_BITS);
+    ref_send(0x03, FOUR_BITS);
+    ref_send(0x03, FOUR_BITS);
+    ref_send(0x02, FOUR_BITS);
+    ref_send(LCD_FUNCTIONSET | LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS, COMMAND);
+    ref_send(LCD_DISPLAYCONTROL | LCD_DISPLAYON, COMMAND);
+    ref_send(LCD_CLEARDISPLAY, COMMAND);
+    ref_send(LCD_ENTRYMODESET | LCD_ENTRYLEFT, COMMAND);
+    ref_send(LCD_DISPLAYCONTROL | LCD_DISPLAYON, COMMAND);
+    check_stream();
+
+    // but in far fewer transactions: 36 bytes, 9 transfers
+    CHECK_EQ(log_end - log_start, 9);
+
+    CHECK(lcd.first_latch_us - start_us >= POWER_ON_US);
+    CHECK_EQ(lcd.init_writes, 4);
+    CHECK(lcd.four_bit);
+    CHECK(!lcd.high_nibble_done);
+    CHECK_EQ(lcd.function, LCD_FUNCTIONSET | LCD_2LINE);
+    CHECK_EQ(lcd.control, LCD_DISPLAYCONTROL | LCD_DISPLAYON);
+    CHECK_EQ(lcd.entry, LCD_ENTRYMODESET | LCD_ENTRYLEFT);
+    CHECK_EQ(lcd.busy_violations, 0);
+    check_row(0x00, "                ");
+    check_row(0x40, "                ");
+}
+
+static void test_flush(void)
+{
+    size_t log_start, log_end;
+
+    stream_len = ref_len = 0;
+    MOCK_I2C_log(&log_start);
+    LCD_I2C_fbWrite(0, 0, "12:34:56");
+    LCD_I2C_fbWrite(0, 1, "Mo 19.10.2026");
+    CHECK_EQ(LCD_I2C_flush(), ESP_OK);
+    drain();
+    MOCK_I2C_log(&log_end);
+
+    // the old driver moved the cursor with setCursor() and wrote each cell with write(), the blank
+    // after the weekday is already on the display
+    ref_print("12:34:56");
+    ref_send(LCD_SETDDRAMADDR | 0x40, COMMAND);
+    ref_print("Mo");
+    ref_send(LCD_SETDDRAMADDR | 0x43, COMMAND);
+    ref_print("19.10.2026");
+    check_stream();
+    CHECK_EQ(log_end - log_start, 2); // one transaction per row
+    check_row(0x00, "12:34:56        ");
+    check_row(0x40, "Mo 19.10.2026   ");
+
+    // only the changed cell is sent, the cursor is moved there first
+    stream_len = ref_len = 0;
+    LCD_I2C_fbWrite(7, 0, "7");
+    CHECK_EQ(LCD_I2C_flush(), ESP_OK);
+    drain();
+    ref_send(LCD_SETDDRAMADDR | 0x07, COMMAND);
+    ref_print("7");
+    check_stream();
+    check_row(0x00, "12:34:57        ");
+
+    // nothing changed, nothing sent
+    stream_len = ref_len = 0;
+    CHECK_EQ(LCD_I2C_flush(), ESP_OK);
+    drain();
+    CHECK_EQ(stream_len, 0);
+    CHECK_EQ(lcd.busy_violations, 0);
+}
+
+static void test_clear_and_print(void)
+{
+    stream_len = ref_len = 0;
+    LCD_I2C_clear();
+    LCD_I2C_setCursor(4, 1);
+    CHECK_EQ(LCD_I2C_print("GPS"), ESP_OK);
+    LCD_I2C_home();
+    CHECK_EQ(LCD_I2C_print("ok"), ESP_OK);
+    drain();
+
+    ref_send(LCD_CLEARDISPLAY, COMMAND);
+    ref_send(LCD_SETDDRAMADDR | 0x44, COMMAND);
+    ref_print("GPS");
+    ref_send(LCD_RETURNHOME, COMMAND);
+    ref_print("ok");
+    check_stream();
+
+    // the commands after clear and home must wait for their execution
+    CHECK_EQ(lcd.busy_violations, 0);
+    check_row(0x00, "ok              ");
+    check_row(0x40, "    GPS         ");
+}
+
+static void test_create_char(void)
+{
+    static const uint8_t pattern[8] = { 0x0E, 0x11, 0x11, 0x1F, 0x1B, 0x1B, 0x1F, 0x00 };
+    size_t log_start, log_end;
+
+    stream_len = ref_len = 0;
+    MOCK_I2C_log(&log_start);
+    LCD_I2C_createChar(2, pattern);
+    drain();
+    MOCK_I2C_log(&log_end);
+
+    ref_send(LCD_SETCGRAMADDR | (2 << 3), COMMAND);
+    for (uint8_t idx = 0; idx < sizeof(pattern); idx++)
+    {
+        ref_send(pattern[idx], LCD_DATA);
+    }
+    check_stream();
+    CHECK_EQ(log_end - log_start, 1);
+    CHECK(memcmp(&lcd.cgram_data[2 * 8], pattern, sizeof(pattern)) == 0);
+
+    // the address counter is in CGRAM now, the next flush has to set the cursor. The framebuffer was
+    // blanked by the clear, so the text printed directly is overwritten as well
+    stream_len = ref_len = 0;
+    LCD_I2C_fbWrite(0, 0, "x");
+    CHECK_EQ(LCD_I2C_flush(), ESP_OK);
+    drain();
+    ref_send(LCD_SETDDRAMADDR | 0x00, COMMAND);
+    ref_print("x ");
+    ref_send(LCD_SETDDRAMADDR | 0x44, COMMAND);
+    ref_print("   ");
+    check_stream();
+    check_row(0x00, "x               ");
+    check_row(0x40, "                ");
+    CHECK_EQ(lcd.busy_violations, 0);
+}
+
+static void test_recovery(void)
+{
+    // a transfer is lost, the error only shows with the next commit
+    fail_cnt = 1;
+    LCD_I2C_fbWrite(0, 0, "AB");
+    CHECK_EQ(LCD_I2C_flush(), ESP_OK);
+    drain();
+    check_row(0x00, "x               ");
+
+    // reported once, the new content still goes out
+    stream_len = 0;
+    LCD_I2C_fbWrite(0, 0, "CD");
+    CHECK(LCD_I2C_flush() != ESP_OK);
+    drain();
+    CHECK(stream_len > 0);
+    check_row(0x00, "CD              ");
+
+    // unclear what the lost transfer did, so everything is sent again
+    stream_len = 0;
+    LCD_I2C_fbWrite(0, 1, "ok");
+    CHECK_EQ(LCD_I2C_flush(), ESP_OK);
+    drain();
+    CHECK(stream_len >= 2 * 16 * 4);
+    check_row(0x00, "CD              ");
+    check_row(0x40, "ok              ");
+
+    stream_len = 0;
+    CHECK_EQ(LCD_I2C_flush(), ESP_OK);
+    drain();
+    CHECK_EQ(stream_len, 0);
+    CHECK_EQ(lcd.busy_violations, 0);
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_begin);
+    RUN(test_flush);
+    RUN(test_clear_and_print);
+    RUN(test_create_char);
+    RUN(test_recovery);
+    return UNIT_RESULT();
+}
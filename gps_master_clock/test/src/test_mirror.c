@@ -0,0 +1,232 @@
+#include <string.h>
+
+#include "unit.h"
+#include "mock.h"
+#include "mirror.h"
+#include "custom_main.h"
+#include "esp_rom_crc.h"
+#include "TinyGPS_wrapper.h"
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+// layout 1, ram_mirror_t of the firmware before the header was introduced, written as raw struct
+typedef struct
+{
+    time_t last_connected_utc;
+    int current_minutes_12o_clock;
+    uint32_t total_pos_time_corrected;
+    uint32_t total_neg_time_corrected;
+    uint32_t total_uptime_seconds;
+    uint32_t mirror_saved_times;
+    uint32_t magic_word;
+    uint16_t pulse_len_ms;
+    uint16_t pulse_pause_ms;
+} layout_1_t;
+
+// layout 2, header + struct
+typedef struct
+{
+    uint16_t version;
+    uint16_t len;
+    uint32_t crc;
+    ram_mirror_t rm;
+} layout_2_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static nvs_handle_t nvs;
+
+static const ram_mirror_t sample =
+{
+    .last_connected_utc = 1700000000,
+    .current_minutes_12o_clock = 437,
+    .total_pos_time_corrected = 12,
+    .total_neg_time_corrected = 3,
+    .total_uptime_seconds = 987654,
+    .mirror_saved_times = 42,
+    .magic_word = RAM_MIRROR_VALID_MAGIC,
+    .pulse_len_ms = 150,
+    .pulse_pause_ms = 250,
+    .last_lat_e7 = 481234567,
+    .last_lon_e7 = -116000000,
+    .last_alt_cm = 52000,
+    .last_pos_valid = 1,
+};
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static void check_rm(const ram_mirror_t* expected)
+{
+    CHECK_EQ(rm.last_connected_utc, expected->last_connected_utc);
+    CHECK_EQ(rm.current_minutes_12o_clock, expected->current_minutes_12o_clock);
+    CHECK_EQ(rm.total_pos_time_corrected, expected->total_pos_time_corrected);
+    CHECK_EQ(rm.total_neg_time_corrected, expected->total_neg_time_corrected);
+    CHECK_EQ(rm.total_uptime_seconds, expected->total_uptime_seconds);
+    CHECK_EQ(rm.mirror_saved_times, expected->mirror_saved_times);
+    CHECK_EQ(rm.magic_word, expected->magic_word);
+    CHECK_EQ(rm.pulse_len_ms, expected->pulse_len_ms);
+    CHECK_EQ(rm.pulse_pause_ms, expected->pulse_pause_ms);
+    CHECK_EQ(rm.last_lat_e7, expected->last_lat_e7);
+    CHECK_EQ(rm.last_lon_e7, expected->last_lon_e7);
+    CHECK_EQ(rm.last_alt_cm, expected->last_alt_cm);
+    CHECK_EQ(rm.last_pos_valid, expected->last_pos_valid);
+}
+
+static void test_crc(void)
+{
+    // check value of CRC-32/ISO-HDLC, to make sure the mock computes what the ROM does
+    CHECK_EQ(esp_rom_crc32_le(0, (const uint8_t*)"123456789", 9), 0xCBF43926);
+
+    MOCK_log_init();
+    CHECK_EQ(nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs), ESP_OK);
+}
+
+static void test_layout_2(void)
+{
+    static layout_2_t stored;
+    size_t len = sizeof(stored);
+
+    MOCK_NVS_reset();
+    CHECK_EQ(MIRROR_load(nvs), ESP_ERR_NVS_NOT_FOUND);
+
+    rm = sample;
+    CHECK_EQ(MIRROR_save(nvs), ESP_OK);
+    CHECK_EQ(nvs_get_blob(nvs, KEY_RAM_MIRROR, &stored, &len), ESP_OK);
+    CHECK_EQ(len, sizeof(layout_2_t));
+    CHECK_EQ(stored.version, 2);
+    CHECK_EQ(stored.version, RAM_MIRROR_VERSION);
+    CHECK_EQ(stored.len, sizeof(ram_mirror_t));
+    CHECK_EQ(stored.crc, esp_rom_crc32_le(0, (const uint8_t*)&stored.rm, sizeof(stored.rm)));
+
+    rm = (ram_mirror_t){0};
+    CHECK_EQ(MIRROR_load(nvs), ESP_OK);
+    check_rm(&sample);
+    CHECK(MIRROR_rtc_valid());
+}
+
+static void test_layout_1(void)
+{
+    // as written by the firmware before the header, e.g. after a firmware update
+    const layout_1_t old =
+    {
+        .last_connected_utc = 1600000000,
+        .current_minutes_12o_clock = 719,
+        .total_pos_time_corrected = 5,
+        .total_neg_time_corrected = 6,
+        .total_uptime_seconds = 7,
+        .mirror_saved_times = 8,
+        .magic_word = RAM_MIRROR_VALID_MAGIC,
+        .pulse_len_ms = 100,
+        .pulse_pause_ms = 300,
+    };
+    const ram_mirror_t migrated =
+    {
+        .last_connected_utc = 1600000000,
+        .current_minutes_12o_clock = 719,
+        .total_pos_time_corrected = 5,
+        .total_neg_time_corrected = 6,
+        .total_uptime_seconds = 7,
+        .mirror_saved_times = 8,
+        .magic_word = RAM_MIRROR_VALID_MAGIC,
+        .pulse_len_ms = 100,
+        .pulse_pause_ms = 300,
+        .last_alt_cm = TINYGPS_WRAPPER_INVALID_ALTITUDE,
+        .last_pos_valid = 0,
+    };
+
+    MOCK_NVS_reset();
+    CHECK_EQ(nvs_set_blob(nvs, KEY_RAM_MIRROR, &old, sizeof(old)), ESP_OK);
+    rm = sample;
+    CHECK_EQ(MIRROR_load(nvs), ESP_OK);
+    check_rm(&migrated);
+    CHECK(MIRROR_rtc_valid());
+
+    // the next save writes layout 2, which loads the same
+    size_t len = 0;
+    CHECK_EQ(MIRROR_save(nvs), ESP_OK);
+    CHECK_EQ(nvs_get_blob(nvs, KEY_RAM_MIRROR, NULL, &len), ESP_OK);
+    CHECK_EQ(len, sizeof(layout_2_t));
+    rm = sample;
+    CHECK_EQ(MIRROR_load(nvs), ESP_OK);
+    check_rm(&migrated);
+
+    // layout 1 is only recognized with the magic word
+    layout_1_t garbage = old;
+    garbage.magic_word = 0xFFFFFFFF;
+    CHECK_EQ(nvs_set_blob(nvs, KEY_RAM_MIRROR, &garbage, sizeof(garbage)), ESP_OK);
+    rm = sample;
+    CHECK_EQ(MIRROR_load(nvs), ESP_ERR_INVALID_VERSION);
+    check_rm(&sample);
+}
+
+static void test_rejected(void)
+{
+    static layout_2_t stored;
+    static uint8_t big[sizeof(layout_2_t) + 1];
+    size_t len = sizeof(stored);
+
+    MOCK_NVS_reset();
+    rm = sample;
+    CHECK_EQ(MIRROR_save(nvs), ESP_OK);
+    CHECK_EQ(nvs_get_blob(nvs, KEY_RAM_MIRROR, &stored, &len), ESP_OK);
+
+    // flipped bit in the payload, rm stays untouched
+    stored.rm.current_minutes_12o_clock ^= 0x10;
+    CHECK_EQ(nvs_set_blob(nvs, KEY_RAM_MIRROR, &stored, sizeof(stored)), ESP_OK);
+    rm.current_minutes_12o_clock = 1;
+    CHECK_EQ(MIRROR_load(nvs), ESP_ERR_INVALID_CRC);
+    CHECK_EQ(rm.current_minutes_12o_clock, 1);
+    stored.rm.current_minutes_12o_clock ^= 0x10;
+
+    // same size, but a different version
+    stored.version = RAM_MIRROR_VERSION + 1;
+    CHECK_EQ(nvs_set_blob(nvs, KEY_RAM_MIRROR, &stored, sizeof(stored)), ESP_OK);
+    CHECK_EQ(MIRROR_load(nvs), ESP_ERR_INVALID_CRC);
+
+    // written by a newer firmware with a larger struct
+    CHECK_EQ(nvs_set_blob(nvs, KEY_RAM_MIRROR, big, sizeof(big)), ESP_OK);
+    CHECK_EQ(MIRROR_load(nvs), ESP_ERR_INVALID_SIZE);
+
+    // a size which matches no layout
+    CHECK_EQ(nvs_set_blob(nvs, KEY_RAM_MIRROR, big, sizeof(layout_1_t) + 4), ESP_OK);
+    CHECK_EQ(MIRROR_load(nvs), ESP_ERR_INVALID_VERSION);
+    CHECK_EQ(rm.current_minutes_12o_clock, 1);
+}
+
+static void test_rtc_checkpoint(void)
+{
+    rm = sample;
+    MIRROR_checkpoint();
+    CHECK(MIRROR_rtc_valid());
+
+    // reset between the modification and the checkpoint: the RTC copy is torn, the boot falls back to NVS
+    rm.total_uptime_seconds++;
+    CHECK(!MIRROR_rtc_valid());
+    MIRROR_checkpoint();
+    CHECK(MIRROR_rtc_valid());
+
+    // consistent, but never initialized
+    rm.magic_word = 0;
+    MIRROR_checkpoint();
+    CHECK(!MIRROR_rtc_valid());
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_crc);
+    RUN(test_layout_2);
+    RUN(test_layout_1);
+    RUN(test_rejected);
+    RUN(test_rtc_checkpoint);
+    return UNIT_RESULT();
+}
@@ -0,0 +1,251 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "unit.h"
+#include "TinyGPS_wrapper.h"
+#include "timekeep.h"
+
+/* Replays one corpus of nmea/ through TinyGPS_wrapper as NEO6M_Task does: every completed sentence is cracked,
+ * the accepted timestamps have to match <corpus>.expected. Lines starting with '#' are comments and not fed to the
+ * parser, everything else is, including the line noise. The wrapper keeps its TinyGPS instance for the lifetime
+ * of the process, so there is one process per corpus.
+ * The throughput is compared with <corpus>.baseline, the ps/byte recorded on the machine which runs the tests.
+ * With --record both files are written from the replay instead, review the diff before committing it. */
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define MAX_CORPUS_LEN      (64 * 1024)
+#define MAX_ACCEPTED        256
+
+#define TIMING_ROUNDS       5 // the fastest round counts, the others had interruptions
+#define TIMING_PASSES       40 // per round
+#define MAX_SLOWDOWN        2 // against the baseline, the host timing is noisy. On the target see NEO6M_print_stats()
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+typedef struct
+{
+    time_t utc[MAX_ACCEPTED];
+    uint32_t cnt;
+    uint32_t bytes;     // fed to the parser, without the comments
+    uint32_t sentences;
+} replay_result_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static const char* corpus;
+static bool record;
+static char nmea[MAX_CORPUS_LEN];
+static size_t nmea_len;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static FILE* open_file(const char* ext, const char* mode)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s%s", NMEA_CORPUS_DIR, corpus, ext);
+
+    FILE* f = fopen(path, mode);
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: cannot open\n", path);
+    }
+    return f;
+}
+
+static size_t load(const char* ext, char* buf, size_t buf_len)
+{
+    FILE* f = open_file(ext, "rb");
+    if (f == NULL)
+        return 0;
+    size_t len = fread(buf, 1, buf_len - 1, f);
+    CHECK(feof(f)); // larger than buf_len otherwise
+    fclose(f);
+    buf[len] = 0;
+    return len;
+}
+
+static void replay(replay_result_t* res)
+{
+    bool line_start = true;
+
+    memset(res, 0, sizeof(*res));
+    for (size_t idx = 0; idx < nmea_len; idx++)
+    {
+        char c = nmea[idx];
+        if (line_start && c == '#')
+        { // comment, up to the end of the line
+            while (idx < nmea_len && nmea[idx] != '\n')
+                idx++;
+            continue;
+        }
+        line_start = (c == '\n');
+        res->bytes++;
+
+        if (!TinyGPS_wrapper_encode(c))
+            continue;
+
+        struct tm local;
+        time_t utc;
+        uint32_t age;
+        res->sentences++;
+        if (TinyGPS_wrapper_crack_datetime(&local, &utc, &age) == 0 && res->cnt < MAX_ACCEPTED)
+        {
+            res->utc[res->cnt++] = utc;
+        }
+    }
+}
+
+static void test_accepted(void)
+{
+    static char text[16 * 1024];
+    static replay_result_t res;
+    time_t expected[MAX_ACCEPTED];
+    uint32_t expected_cnt = 0;
+
+    nmea_len = load(".nmea", nmea, sizeof(nmea));
+    CHECK(nmea_len > 0);
+
+    if (record)
+    {
+        replay(&res);
+        FILE* f = open_file(".expected", "w");
+        CHECK(f != NULL);
+        if (f == NULL)
+            return;
+        fprintf(f, "# utc of every accepted timestamp of %s.nmea, in order. Recorded by test_nmea_replay --record\n",
+            corpus);
+        for (uint32_t idx = 0; idx < res.cnt; idx++)
+        {
+            fprintf(f, "%lld\n", (long long)res.utc[idx]);
+        }
+        fclose(f);
+        return;
+    }
+
+    CHECK(load(".expected", text, sizeof(text)) > 0);
+
+    for (char* line = strtok(text, "\r\n"); line != NULL && expected_cnt < MAX_ACCEPTED; line = strtok(NULL, "\r\n"))
+    {
+        if (line[0] != '#')
+        {
+            expected[expected_cnt++] = strtoll(line, NULL, 10);
+        }
+    }
+
+    replay(&res);
+    CHECK_EQ(res.cnt, expected_cnt);
+    for (uint32_t idx = 0; idx < res.cnt && idx < expected_cnt; idx++)
+    {
+        if (res.utc[idx] != expected[idx])
+        {
+            fprintf(stderr, "%s: timestamp %lu\n", corpus, idx);
+            CHECK_EQ(res.utc[idx], expected[idx]);
+            break; // the rest is most likely shifted
+        }
+    }
+}
+
+static void test_throughput(void)
+{
+    static replay_result_t res;
+    uint64_t best_ns = UINT64_MAX;
+    uint64_t bytes = 0;
+    uint32_t sentences = 0;
+
+    for (uint32_t round = 0; round < TIMING_ROUNDS; round++)
+    {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t pass = 0; pass < TIMING_PASSES; pass++)
+        {
+            replay(&res);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        uint64_t elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+        if (elapsed_ns < best_ns)
+            best_ns = elapsed_ns;
+        bytes = (uint64_t)res.bytes * TIMING_PASSES;
+        sentences = res.sentences * TIMING_PASSES;
+    }
+    if (best_ns == 0 || bytes == 0)
+        return;
+
+    uint64_t ps_per_byte = best_ns * 1000 / bytes; // the host is fast, ns/byte would be a small integer
+    printf("%s: %llu bytes, %llu.%03lluns/byte, %llu sentences/s\n", corpus, bytes, ps_per_byte / 1000,
+        ps_per_byte % 1000, sentences * 1000000000ULL / best_ns);
+
+    if (record)
+    {
+        FILE* f = open_file(".baseline", "w");
+        CHECK(f != NULL);
+        if (f == NULL)
+            return;
+        fprintf(f, "# ps/byte of the replay of %s.nmea on the machine running the tests. Recorded by "
+            "test_nmea_replay --record\n%llu\n", corpus, ps_per_byte);
+        fclose(f);
+        return;
+    }
+
+    char text[256];
+    uint64_t baseline_ps = 0;
+    if (load(".baseline", text, sizeof(text)) > 0)
+    {
+        for (char* line = strtok(text, "\r\n"); line != NULL; line = strtok(NULL, "\r\n"))
+        {
+            if (line[0] != '#')
+                baseline_ps = strtoull(line, NULL, 10);
+        }
+    }
+    if (baseline_ps == 0)
+    {
+        fprintf(stderr, "%s: no baseline, record it with: test_nmea_replay %s --record\n", corpus, corpus);
+        CHECK(baseline_ps != 0);
+        return;
+    }
+    printf("%s: %.2fx the baseline\n", corpus, (double)ps_per_byte / baseline_ps);
+    CHECK(ps_per_byte <= baseline_ps * MAX_SLOWDOWN);
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+// timekeep.c, there is no other task converting times here
+void take_tz_mutex(void)
+{
+}
+
+void give_tz_mutex(void)
+{
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "--record") != 0))
+    {
+        fprintf(stderr, "usage: %s <corpus name in %s> [--record]\n", argv[0], NMEA_CORPUS_DIR);
+        return 2;
+    }
+    corpus = argv[1];
+    record = (argc == 3);
+
+    // mktime() in the wrapper takes the GPS time as local time
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    RUN(test_accepted);
+    RUN(test_throughput);
+    return UNIT_RESULT();
+}
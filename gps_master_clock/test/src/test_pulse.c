@@ -0,0 +1,202 @@
+#include "unit.h"
+#include "pulse.h"
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define LEN_US      100000
+#define PAUSE_US    150000
+#define MINUTE      (1760000000 / 60 * 60) // some full minute
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static void init(pulse_t* pulse)
+{
+    PULSE_init(pulse, LEN_US / 1000, PAUSE_US / 1000);
+}
+
+static void test_missed_ticks(void)
+{
+    pulse_t pulse;
+    init(&pulse);
+
+    CHECK_EQ(PULSE_missed_ticks(&pulse, 7), 0); // first tick after boot, nothing to compare to
+    CHECK_EQ(PULSE_missed_ticks(&pulse, 8), 0);
+    CHECK_EQ(PULSE_missed_ticks(&pulse, 11), 2);
+    CHECK_EQ(PULSE_missed_ticks(&pulse, 12), 0);
+
+    pulse.last_seq = UINT32_MAX;
+    CHECK_EQ(PULSE_missed_ticks(&pulse, 1), 1); // across the wrap around of the sequence number
+}
+
+static void test_tick(void)
+{
+    pulse_t pulse;
+    init(&pulse);
+
+    CHECK(!PULSE_tick(&pulse, MINUTE - 2));
+    CHECK(!PULSE_tick(&pulse, MINUTE - 1));
+    CHECK(PULSE_tick(&pulse, MINUTE + 1)); // the tick of second 0 was missed
+    CHECK(!PULSE_tick(&pulse, MINUTE + 2));
+
+    PULSE_commissioning(&pulse, true);
+    CHECK(!PULSE_tick(&pulse, MINUTE + 60));
+    PULSE_commissioning(&pulse, false);
+    CHECK(!PULSE_tick(&pulse, MINUTE + 61)); // that minute was already handled, by skipping it
+}
+
+static void test_pulse_train(void)
+{
+    pulse_t pulse;
+    int face = 10;
+    int minutes = 0;
+    int64_t t = 5000000;
+    init(&pulse);
+
+    CHECK_EQ(PULSE_wakeup_us(&pulse), PULSE_NO_WAKEUP);
+    CHECK_EQ(PULSE_minute_sync(&pulse, face, 13, false, &minutes), CLOCKSYNC_ADVANCE);
+    CHECK_EQ(minutes, 3);
+    CHECK(PULSE_wakeup_us(&pulse) <= t); // right away
+
+    for (int idx = 0; idx < 3; idx++)
+    {
+        CHECK_EQ(PULSE_step(&pulse, t, &face), (idx == 0) ? PULSE_EV_START : (PULSE_EV_DONE | PULSE_EV_START));
+        CHECK_EQ(face, 10 + idx);
+        CHECK_EQ(PULSE_wakeup_us(&pulse), t + LEN_US);
+
+        CHECK_EQ(PULSE_step(&pulse, t + LEN_US - 1, &face), 0); // too early, nothing happens
+        CHECK_EQ(PULSE_step(&pulse, t + LEN_US, &face), PULSE_EV_HIGH);
+        CHECK_EQ(PULSE_wakeup_us(&pulse), t + LEN_US + PAUSE_US);
+        t += LEN_US + PAUSE_US;
+    }
+
+    // woken up late, the pause is over all the same
+    CHECK_EQ(PULSE_step(&pulse, t + 20000, &face), PULSE_EV_DONE | PULSE_EV_FACE);
+    CHECK_EQ(face, 13);
+    CHECK_EQ(pulse.phase, PULSE_IDLE);
+    CHECK_EQ(PULSE_wakeup_us(&pulse), PULSE_NO_WAKEUP);
+}
+
+static void test_sync_during_pulse(void)
+{
+    pulse_t pulse;
+    int face = 10;
+    int minutes = 0;
+    init(&pulse);
+
+    PULSE_minute_sync(&pulse, face, 11, false, &minutes);
+    PULSE_step(&pulse, 0, &face);
+    CHECK_EQ(pulse.phase, PULSE_ACTIVE);
+
+    // the next minute starts while the pulse to 11 is still in progress, it counts as done
+    CHECK_EQ(PULSE_minute_sync(&pulse, face, 11, false, &minutes), CLOCKSYNC_IN_SYNC);
+    CHECK_EQ(PULSE_minute_sync(&pulse, face, 12, false, &minutes), CLOCKSYNC_ADVANCE);
+    CHECK_EQ(minutes, 1);
+    CHECK_EQ(pulse.minutes_diff, 1);
+}
+
+static void test_wait(void)
+{
+    pulse_t pulse;
+    int face = 100;
+    int minutes = 0;
+    init(&pulse);
+
+    // short lead: no pulses, the face is not reported as right
+    CHECK_EQ(PULSE_minute_sync(&pulse, face, 97, false, &minutes), CLOCKSYNC_WAIT_LEAD);
+    CHECK_EQ(pulse.minutes_diff, -3);
+    CHECK_EQ(PULSE_wakeup_us(&pulse), PULSE_NO_WAKEUP);
+    CHECK_EQ(PULSE_step(&pulse, 0, &face), 0);
+
+    // long lead on provisional time: wait for GPS instead of a wrap around
+    CHECK_EQ(PULSE_minute_sync(&pulse, face, 40, true, &minutes), CLOCKSYNC_WAIT_PROVISIONAL);
+    CHECK_EQ(pulse.minutes_diff, -60);
+    CHECK_EQ(PULSE_minute_sync(&pulse, face, 40, false, &minutes), CLOCKSYNC_WRAP_AROUND);
+    CHECK_EQ(pulse.minutes_diff, MINUTES_PER_12H - 60);
+}
+
+static void test_face_report(void)
+{
+    pulse_t pulse;
+    int face = 100;
+    int minutes = 0;
+    init(&pulse);
+
+    // only the first time after boot, per provisional and GPS time
+    PULSE_minute_sync(&pulse, face, 100, true, &minutes);
+    CHECK_EQ(PULSE_step(&pulse, 0, &face), PULSE_EV_FACE);
+    CHECK(pulse.face_provisional);
+    PULSE_minute_sync(&pulse, face, 100, true, &minutes);
+    CHECK_EQ(PULSE_step(&pulse, 0, &face), 0);
+    PULSE_minute_sync(&pulse, face, 100, false, &minutes);
+    CHECK_EQ(PULSE_step(&pulse, 0, &face), PULSE_EV_FACE);
+    CHECK(!pulse.face_provisional);
+    PULSE_minute_sync(&pulse, face, 100, false, &minutes);
+    CHECK_EQ(PULSE_step(&pulse, 0, &face), 0);
+}
+
+static void test_shutdown(void)
+{
+    pulse_t pulse;
+    int face = 10;
+    int minutes = 0;
+    init(&pulse);
+
+    // the pulse in progress is completed, the others are not started
+    PULSE_minute_sync(&pulse, face, 15, false, &minutes);
+    PULSE_step(&pulse, 0, &face);
+    PULSE_shutdown(&pulse);
+    CHECK_EQ(PULSE_wakeup_us(&pulse), LEN_US);
+    CHECK_EQ(PULSE_step(&pulse, LEN_US, &face), PULSE_EV_HIGH);
+    CHECK_EQ(PULSE_step(&pulse, LEN_US + PAUSE_US, &face), PULSE_EV_DONE | PULSE_EV_SUSPEND);
+    CHECK_EQ(face, 11);
+    CHECK_EQ(pulse.phase, PULSE_IDLE);
+
+    // resumed: the rest of the train follows
+    CHECK_EQ(PULSE_step(&pulse, 1000000, &face), PULSE_EV_START);
+
+    // no pulse in progress: right away
+    init(&pulse);
+    PULSE_shutdown(&pulse);
+    CHECK(PULSE_wakeup_us(&pulse) <= 0);
+    CHECK_EQ(PULSE_step(&pulse, 0, &face), PULSE_EV_SUSPEND);
+}
+
+static void test_commissioning(void)
+{
+    pulse_t pulse;
+    int face = 10;
+    int minutes = 0;
+    init(&pulse);
+
+    PULSE_advance(&pulse, 1); // only while commissioning
+    CHECK_EQ(pulse.minutes_diff, 0);
+
+    PULSE_minute_sync(&pulse, face, 20, false, &minutes);
+    PULSE_commissioning(&pulse, true); // drops the pending pulses
+    CHECK_EQ(pulse.minutes_diff, 0);
+    PULSE_advance(&pulse, 60);
+    CHECK_EQ(pulse.minutes_diff, 60);
+    PULSE_commissioning(&pulse, false);
+    CHECK_EQ(pulse.minutes_diff, 0);
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_missed_ticks);
+    RUN(test_tick);
+    RUN(test_pulse_train);
+    RUN(test_sync_during_pulse);
+    RUN(test_wait);
+    RUN(test_face_report);
+    RUN(test_shutdown);
+    RUN(test_commissioning);
+    return UNIT_RESULT();
+}
@@ -0,0 +1,520 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "unit.h"
+#include "clocksync.h"
+#include "pulse.h"
+
+/* Discrete event simulation of a year of master clock operation in virtual time. TIMEKEEP is the firmware's own
+ * state machine (pulse.c) with the clocksync decisions, around it the simulation models the drifting second
+ * timer, GPS fixes, the time source selection of NEO6M and power cycles and resets with the RTC or the time
+ * anchor as provisional time source. The clock face is compared with the true local time at every event. */
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define US_PER_S            1000000LL
+#define DAY_S               (24 * 3600LL)
+
+#define SIM_START_UTC       1767225600LL // 2026-01-01 00:00:00 UTC, covers both DST transitions
+#define SIM_DAYS            365
+
+#define PULSE_LEN_MS        100 // rm_dflt
+#define PULSE_PAUSE_MS      100
+#define PULSE_PERIOD_US     ((PULSE_LEN_MS + PULSE_PAUSE_MS) * 1000LL)
+
+#define GPS_SENTENCE_US     300000 // NMEA output delay after the second
+#define BOOT_DELAY_US       (10 * US_PER_S) // PWR_GOOD_HOLD_US, then booting
+#define TTFF_HOT_US         (5 * US_PER_S)
+#define TTFF_COLD_US        (45 * US_PER_S)
+#define COLD_AFTER_S        (4 * 3600) // off for longer -> cold start of the receiver
+#define NO_RTC              0x7FFFFFFF // rtc_error_s of a power cycle without a usable RTC
+#define SOFT_RESET_AT_S     30 // into the hour, away from the minute sync
+#define SOFT_RESET_US       (2 * US_PER_S) // until NEO6M runs again, the receiver keeps its fix
+#define RTC_TIMER_ERROR     0.03 // the RTC timer runs from the internal RC oscillator
+
+// The face shows the wrong time after every full minute until the tick and the pulse are through. Without GPS
+// the timer drifts freely, before the drift correction it may be MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS off.
+#define MAX_PPM             35.0
+#define LONGEST_OUTAGE_S    (3 * DAY_S)
+#define REGULAR_BOUND_US    ((int64_t)(((MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS + 1) + LONGEST_OUTAGE_S * MAX_PPM * 1e-6) * US_PER_S) \
+                             + GPS_SENTENCE_US + PULSE_PERIOD_US)
+// After a boot or a DST change: fix, the next full minute and at most a full turn of the dial
+#define CATCH_UP_BOUND_US   (BOOT_DELAY_US + TTFF_COLD_US + 2 * 60 * US_PER_S + MINUTES_PER_12H * PULSE_PERIOD_US)
+
+//---------------------------------------------------------------------------
+// Enums
+//---------------------------------------------------------------------------
+
+// event sources, on equal times the lower one goes first
+typedef enum
+{
+    EV_SCRIPT,  // power events
+    EV_TICK,    // second timer
+    EV_PULSE,   // next transition of a pulse
+    EV_GPS,     // NMEA sentence
+    EV_MINUTE,  // true full minute, for the comparison only
+    EV_COUNT
+} event_t;
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+typedef struct
+{
+    int day;
+    int hour;
+    int64_t duration_s;
+} outage_t;
+
+typedef struct
+{
+    int day;
+    int hour;
+    int64_t off_us;
+    int rtc_error_s; // provisional time after the boot is off by this, or NO_RTC
+    bool soft_reset; // panic or watchdog: the power and the RTC timer stay on, the time anchor is kept
+} power_cycle_t;
+
+//---------------------------------------------------------------------------
+// Local constants
+//---------------------------------------------------------------------------
+
+static const outage_t outages[] =
+{
+    {  10, 14, 2 * 3600 },
+    {  40,  3, LONGEST_OUTAGE_S },
+    { 120, 22, 20 * 3600 },
+    { 250,  8, 2 * DAY_S },
+    { 300, 12, 30 * 60 },
+};
+
+static const power_cycle_t power_cycles[] =
+{
+    {  50, 10, 200000, 0 },                             // brownout
+    {  87,  0, 90 * 60 * US_PER_S, 0 },                 // off over the start of DST, 2026-03-29 01:00 UTC
+    { 100, 19, 5 * 3600 * US_PER_S, 1 },                // evening off, RTC good
+    { 150,  6, DAY_S * US_PER_S, NO_RTC },              // RTC battery flat
+    { 200, 11, 30 * 60 * US_PER_S, -90 },               // RTC behind
+    { 230, 23, (5 * 3600 + 20) * US_PER_S, 600 },       // RTC 10 minutes ahead, the fix comes after the first
+                                                        // minute sync, the face wraps around
+    { 260, 15, SOFT_RESET_US, NO_RTC, true },           // watchdog reset, time from the anchor
+    { 290,  4, SOFT_RESET_US, 0, true },                // panic, the RTC goes first
+};
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static int64_t now_us;
+static int64_t next_us[EV_COUNT];
+
+// the firmware
+static struct
+{
+    bool powered;
+    bool timer_running;
+    bool provisional;
+    time_t mcu_utc;
+    double tick_at_us; // exact, the timer period is not a whole number of us
+    int64_t fix_at_us; // the receiver has a fix from then on
+    uint32_t tick_seq; // of NEO6M_get_tick()
+
+    // time anchor in RTC memory, for resets
+    bool anchor_valid;
+    time_t anchor_utc;
+    uint64_t anchor_rtc_us;
+
+    // TIMEKEEP
+    pulse_t pulse;
+    bool suspended;
+    int face; // rm.current_minutes_12o_clock
+    int last_isdst;
+
+    // rm counters
+    uint32_t total_pos_s;
+    uint32_t total_neg_s;
+    uint32_t uptime_s;
+} fw;
+
+static size_t next_power_cycle;
+static bool power_off_pending; // power_cycles[next_power_cycle] is off, the next script event switches it on
+
+static struct
+{
+    int face_correct;
+    int64_t wrong_since_us; // -1 if the face is right or the power is off
+    int64_t last_disturbance_us; // boot or DST change
+    int64_t longest_regular_us;
+    int64_t longest_catch_up_us;
+    int64_t wrong_total_us;
+    uint32_t pulses;
+    uint32_t advances;
+    uint32_t wraparounds;
+    uint32_t waits;
+    uint32_t drift_corrections;
+    uint32_t missed_ticks;
+    uint32_t ticks;
+    uint32_t boots;
+    uint32_t anchor_starts;
+} st;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static time_t true_utc(int64_t t_us)
+{
+    return SIM_START_UTC + t_us / US_PER_S;
+}
+
+static int64_t at(int day, int hour)
+{
+    return (day * DAY_S + hour * 3600LL) * US_PER_S;
+}
+
+static int local_minutes(time_t utc, int* isdst)
+{
+    struct tm local;
+    localtime_r(&utc, &local);
+    if (isdst)
+    {
+        *isdst = local.tm_isdst;
+    }
+    return local.tm_hour * 60 + local.tm_min;
+}
+
+// crystal drift over the seasons
+static double ppm(int64_t t_us)
+{
+    return 10.0 + 25.0 * sin(2 * M_PI * (double)t_us / (365.0 * DAY_S * US_PER_S));
+}
+
+static bool gps_outage(int64_t t_us)
+{
+    for (size_t i = 0; i < sizeof(outages) / sizeof(outages[0]); i++)
+    {
+        int64_t start = at(outages[i].day, outages[i].hour);
+        if (t_us >= start && t_us < start + outages[i].duration_s * US_PER_S)
+            return true;
+    }
+    return false;
+}
+
+// the RTC timer, which keeps running through resets
+static uint64_t rtc_us(int64_t t_us)
+{
+    return (uint64_t)(t_us * (1.0 + RTC_TIMER_ERROR));
+}
+
+static int64_t cycle_start_us(const power_cycle_t* cycle)
+{
+    return at(cycle->day, cycle->hour) + (cycle->soft_reset ? SOFT_RESET_AT_S * US_PER_S : 0);
+}
+
+// TIMEKEEP misses the notification of the tick at 05:00:00 UTC every day, every 10th day also the next one
+static bool tick_missed(time_t utc)
+{
+    time_t s = utc % DAY_S;
+    return (s == 5 * 3600) || (s == 5 * 3600 + 1 && (utc / DAY_S) % 10 == 0);
+}
+
+static void start_ticking(time_t utc)
+{
+    fw.mcu_utc = utc;
+    fw.tick_at_us = (double)now_us;
+    fw.tick_at_us += US_PER_S / (1.0 + ppm(now_us) * 1e-6);
+    next_us[EV_TICK] = (int64_t)fw.tick_at_us;
+    fw.timer_running = true;
+}
+
+// TIMEKEEP after each message, and at the pulse transitions it asked for
+static void timekeep_step(void)
+{
+    if (fw.suspended)
+        return;
+
+    uint32_t events = PULSE_step(&fw.pulse, now_us, &fw.face);
+    st.pulses += (events & PULSE_EV_START) != 0;
+    fw.suspended = (events & PULSE_EV_SUSPEND) != 0;
+
+    int64_t wakeup_us = PULSE_wakeup_us(&fw.pulse);
+    next_us[EV_PULSE] = (fw.suspended || wakeup_us == PULSE_NO_WAKEUP) ? INT64_MAX :
+        (wakeup_us < now_us) ? now_us : wakeup_us;
+}
+
+static void timekeep_tick(time_t utc)
+{
+    uint32_t missed = PULSE_missed_ticks(&fw.pulse, fw.tick_seq);
+    fw.uptime_s += 1 + missed;
+
+    // NEO6M_update_anchor()
+    fw.anchor_valid = true;
+    fw.anchor_utc = utc;
+    fw.anchor_rtc_us = rtc_us(now_us);
+
+    if (PULSE_tick(&fw.pulse, utc))
+    {
+        int isdst;
+        int target = local_minutes(utc, &isdst);
+        if (isdst != fw.last_isdst)
+        {
+            fw.last_isdst = isdst;
+            st.last_disturbance_us = now_us;
+        }
+
+        int minutes;
+        clocksync_action_t action = PULSE_minute_sync(&fw.pulse, fw.face, target, fw.provisional, &minutes);
+        switch (action)
+        {
+        case CLOCKSYNC_WAIT_LEAD:
+        case CLOCKSYNC_WAIT_PROVISIONAL:
+            st.waits++;
+            break;
+        case CLOCKSYNC_WRAP_AROUND:
+            st.wraparounds++;
+            break;
+        case CLOCKSYNC_ADVANCE:
+            st.advances += (minutes > 1); // more than the regular minute step
+            break;
+        default:
+            break;
+        }
+    }
+    timekeep_step();
+}
+
+static void on_tick(void)
+{
+    fw.mcu_utc++;
+    fw.tick_seq++;
+    fw.tick_at_us += US_PER_S / (1.0 + ppm(now_us) * 1e-6);
+    next_us[EV_TICK] = (int64_t)fw.tick_at_us;
+    st.ticks++;
+
+    if (tick_missed(fw.mcu_utc))
+    {
+        st.missed_ticks++;
+        return;
+    }
+    timekeep_tick(fw.mcu_utc);
+}
+
+static void on_pulse(void)
+{
+    timekeep_step();
+}
+
+static void on_gps(void)
+{
+    next_us[EV_GPS] += US_PER_S;
+    if (!fw.powered || now_us < fw.fix_at_us || gps_outage(now_us))
+        return;
+
+    time_t gps_utc = true_utc(now_us);
+    if (!fw.timer_running)
+    {
+        start_ticking(gps_utc);
+    }
+
+    time_t clock_diff = fw.mcu_utc - gps_utc;
+    if (CLOCKSYNC_drift_correction(clock_diff, fw.provisional, &fw.total_pos_s, &fw.total_neg_s))
+    {
+        st.drift_corrections += !fw.provisional;
+        start_ticking(gps_utc);
+    }
+    fw.provisional = false;
+}
+
+static void boot(void)
+{
+    const power_cycle_t* cycle = &power_cycles[next_power_cycle];
+
+    st.boots++;
+    st.last_disturbance_us = now_us;
+    fw.powered = true;
+    fw.timer_running = false;
+    fw.provisional = false;
+    fw.tick_seq = 0;
+    fw.fix_at_us = now_us + ((cycle->off_us > COLD_AFTER_S * US_PER_S) ? TTFF_COLD_US : TTFF_HOT_US);
+    next_us[EV_TICK] = INT64_MAX;
+    next_us[EV_PULSE] = INT64_MAX;
+    PULSE_init(&fw.pulse, PULSE_LEN_MS, PULSE_PAUSE_MS);
+    fw.suspended = false;
+
+    // seed_from_rtc() || seed_from_anchor()
+    time_t utc;
+    if (cycle->rtc_error_s != NO_RTC)
+    {
+        fw.provisional = true;
+        start_ticking(true_utc(now_us) + cycle->rtc_error_s);
+    }
+    else if (fw.anchor_valid && CLOCKSYNC_anchor_utc(fw.anchor_utc, fw.anchor_rtc_us, rtc_us(now_us), &utc))
+    {
+        st.anchor_starts++;
+        fw.provisional = true;
+        start_ticking(utc);
+    }
+}
+
+static void on_script(void)
+{
+    const power_cycle_t* cycle = &power_cycles[next_power_cycle];
+
+    if (!power_off_pending && cycle->soft_reset)
+    { // everything stops right away, the RTC memory with the anchor is kept
+        fw.powered = false;
+        fw.timer_running = false;
+        fw.suspended = true;
+        next_us[EV_TICK] = INT64_MAX;
+        next_us[EV_PULSE] = INT64_MAX; // a pulse in progress is cut off, it did not move the face
+        power_off_pending = true;
+        next_us[EV_SCRIPT] = now_us + cycle->off_us;
+        return;
+    }
+    if (!power_off_pending)
+    { // power fails: TIMEKEEP completes a pulse in progress on the held up rail, then everything stops
+        fw.powered = false;
+        fw.timer_running = false;
+        fw.anchor_valid = false;
+        next_us[EV_TICK] = INT64_MAX;
+        PULSE_shutdown(&fw.pulse);
+        timekeep_step();
+        power_off_pending = true;
+        next_us[EV_SCRIPT] = now_us + cycle->off_us + BOOT_DELAY_US;
+        return;
+    }
+
+    boot();
+    power_off_pending = false;
+    next_power_cycle++;
+    next_us[EV_SCRIPT] = (next_power_cycle < sizeof(power_cycles) / sizeof(power_cycles[0])) ?
+        cycle_start_us(&power_cycles[next_power_cycle]) : INT64_MAX;
+}
+
+static void end_wrong_stretch(void)
+{
+    if (st.wrong_since_us < 0)
+        return;
+
+    int64_t len = now_us - st.wrong_since_us;
+    st.wrong_total_us += len;
+    if (st.wrong_since_us - st.last_disturbance_us < CATCH_UP_BOUND_US)
+    {
+        if (len > st.longest_catch_up_us)
+            st.longest_catch_up_us = len;
+    }
+    else if (len > st.longest_regular_us)
+    {
+        st.longest_regular_us = len;
+        if (len > REGULAR_BOUND_US)
+        {
+            printf("wrong for %.1fs from day %.3f\n", len / 1e6, st.wrong_since_us / (double)(DAY_S * US_PER_S));
+        }
+    }
+    st.wrong_since_us = -1;
+}
+
+// compare the face after every event, it only changes at pulse edges and the correct time at full minutes
+static void check_face(void)
+{
+    // the face can not move while the power is off, only measure while the clock can do something about it
+    bool wrong = (fw.face != st.face_correct) && (fw.powered || fw.pulse.phase != PULSE_IDLE);
+    if (wrong && st.wrong_since_us < 0)
+    {
+        st.wrong_since_us = now_us;
+    }
+    else if (!wrong)
+    {
+        end_wrong_stretch();
+    }
+}
+
+static void run(int64_t end_us)
+{
+    while (1)
+    {
+        event_t ev = EV_SCRIPT;
+        for (int i = 1; i < EV_COUNT; i++)
+        {
+            if (next_us[i] < next_us[ev])
+                ev = i;
+        }
+        if (next_us[ev] >= end_us)
+            break;
+        now_us = next_us[ev];
+
+        switch (ev)
+        {
+        case EV_SCRIPT:
+            on_script();
+            break;
+        case EV_TICK:
+            on_tick();
+            break;
+        case EV_PULSE:
+            on_pulse();
+            break;
+        case EV_GPS:
+            on_gps();
+            break;
+        case EV_MINUTE:
+            st.face_correct = local_minutes(true_utc(now_us), NULL) % MINUTES_PER_12H;
+            next_us[EV_MINUTE] += 60 * US_PER_S;
+            break;
+        default:
+            break;
+        }
+        check_face();
+    }
+    now_us = end_us;
+    end_wrong_stretch();
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1); // as TIMEKEEP
+    tzset();
+
+    // in sync and powered, the receiver has not yet got its fix and there is no RTC
+    st.face_correct = local_minutes(SIM_START_UTC, &fw.last_isdst) % MINUTES_PER_12H;
+    st.wrong_since_us = -1;
+    fw.face = st.face_correct;
+    fw.powered = true;
+    PULSE_init(&fw.pulse, PULSE_LEN_MS, PULSE_PAUSE_MS);
+    fw.fix_at_us = TTFF_COLD_US;
+    next_us[EV_SCRIPT] = cycle_start_us(&power_cycles[0]);
+    next_us[EV_TICK] = INT64_MAX;
+    next_us[EV_PULSE] = INT64_MAX;
+    next_us[EV_GPS] = GPS_SENTENCE_US;
+    next_us[EV_MINUTE] = 60 * US_PER_S;
+
+    run(at(SIM_DAYS, 0) + 30 * US_PER_S); // not on a full minute, the face may lead the true time by a second
+
+    printf("simulated %d days, %lu boots (%lu from the time anchor), %lu missed ticks\n", SIM_DAYS, st.boots,
+        st.anchor_starts, st.missed_ticks);
+    printf("pulses: %lu, catch up advances: %lu, wraparounds: %lu, waits: %lu\n",
+        st.pulses, st.advances, st.wraparounds, st.waits);
+    printf("drift corrections: %lu, +%lus -%lus\n", st.drift_corrections, fw.total_pos_s, fw.total_neg_s);
+    printf("time off correct: %.1fs (%.4f%%), longest %.1fs regular, %.1fs after boot/DST change\n",
+        st.wrong_total_us / 1e6, 100.0 * st.wrong_total_us / at(SIM_DAYS, 0),
+        st.longest_regular_us / 1e6, st.longest_catch_up_us / 1e6);
+
+    CHECK(st.longest_regular_us <= REGULAR_BOUND_US);
+    CHECK(st.longest_catch_up_us <= CATCH_UP_BOUND_US);
+    CHECK_EQ(fw.face, st.face_correct);
+    CHECK_EQ(st.boots, sizeof(power_cycles) / sizeof(power_cycles[0]));
+    CHECK_EQ(st.anchor_starts, 1);
+    CHECK_EQ(fw.uptime_s, st.ticks); // the missed ticks are accounted
+    // DST end 2026-10-25 while running, and the RTC which was 10 minutes ahead
+    CHECK_EQ(st.wraparounds, 2);
+    CHECK(st.drift_corrections > 0);
+    CHECK(fw.total_pos_s > 0 && fw.total_neg_s > 0);
+    return UNIT_RESULT();
+}
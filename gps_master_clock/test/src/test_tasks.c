@@ -0,0 +1,182 @@
+#include <string.h>
+
+#include "unit.h"
+#include "mock.h"
+#include "custom_main.h"
+#include "bsp.h"
+#include "neo6m.h"
+#include "timekeep.h"
+
+/* NEO6M_Task and TIMEKEEP_Task as they are, on the mocks: the second timer runs on the virtual time, the
+ * receiver is a scripted UART with a fake parser (mock_gps.c) and the pulses are taken from the GPIO log. There
+ * is no RTC module on the I2C bus and the boot is a power on, so the first GPS fix starts the clock. The tests
+ * run in order, the task state in static variables carries over like on the target. */
+
+//---------------------------------------------------------------------------
+// Defines
+//---------------------------------------------------------------------------
+
+#define US_PER_S            1000000LL
+
+#define FIX_UTC             1767225640LL // 2026-01-01 00:00:40 UTC, 01:00:40 in Berlin
+#define FACE_MINUTES        57 // 12:57, the minute sync at 01:01 needs 4 pulses
+#define TARGET_MINUTES      61
+#define DRIFT_S             (MAX_ALLOWED_LOCAL_CLOCK_DRIFT_SECONDS + 3)
+
+#define PULSE_LEN_MS        100
+#define PULSE_PAUSE_MS      100
+
+#define SENTENCE            "$GPRMC,000040.00,A,4808.23200,N,01134.53000,E,0.0,,010126,,,A*6C\r\n" // not parsed
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static int64_t shutdown_us; // TIMEKEEP is shut down once the virtual time reaches it, 0 if already sent
+static task_msg_t last_local_time;
+static uint32_t local_time_cnt;
+static uint32_t lock_msg_cnt;
+static GPS_LOCK_STATE_t last_lock_state;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+// the LCD task and the power fail handling, while the task under test blocks
+static bool other_tasks(void)
+{
+    bool progress = false;
+    task_msg_t msg;
+
+    while (receiveTaskMessage(TASK_LCD, 0, &msg))
+    {
+        if (msg.cmd == TASK_CMD_LOCAL_TIME)
+        {
+            last_local_time = msg;
+            local_time_cnt++;
+        }
+        else if (msg.cmd == TASK_CMD_GPS_LOCK_STATE)
+        {
+            last_lock_state = msg.lock_state;
+            lock_msg_cnt++;
+        }
+        progress = true;
+    }
+
+    if (shutdown_us != 0 && esp_timer_get_time() >= shutdown_us)
+    {
+        task_msg_t shutdown = {.dst = TASK_TIMEKEEP, .cmd = TASK_CMD_SHUTDOWN };
+        sendTaskMessage(&shutdown);
+        shutdown_us = 0;
+        progress = true;
+    }
+    return progress;
+}
+
+static void receive_fix(time_t utc)
+{
+    MOCK_GPS_set_fix(utc);
+    MOCK_UART_receive(SENTENCE);
+    MOCK_run_task(NEO6M_Task, NULL);
+    other_tasks();
+}
+
+//---------------------------------------------------------------------------
+// Tests
+//---------------------------------------------------------------------------
+
+static void test_first_fix(void)
+{
+    task_msg_t tick;
+
+    receive_fix(FIX_UTC);
+    CHECK_EQ(rm.last_connected_utc, FIX_UTC);
+    CHECK_EQ(lock_msg_cnt, 1);
+    CHECK_EQ(last_lock_state, GPS_LOCKED);
+
+    // the timer starts with the sentence, the first tick is a second later
+    uint32_t seq = NEO6M_get_tick(&tick);
+    MOCK_advance_us(US_PER_S);
+    CHECK_EQ(NEO6M_get_tick(&tick), seq + 1);
+    CHECK_EQ(tick.utc_time, FIX_UTC + 1);
+    CHECK(!tick.provisional);
+    CHECK_EQ(tick.tick_us, esp_timer_get_time());
+}
+
+static void test_drift_correction(void)
+{
+    task_msg_t tick;
+    uint32_t corrected = rm.total_pos_time_corrected + rm.total_neg_time_corrected;
+
+    // the receiver is a few seconds ahead of the local clock, e.g. after the timer was halted
+    NEO6M_get_tick(&tick);
+    receive_fix(tick.utc_time + DRIFT_S);
+    CHECK_EQ(rm.total_pos_time_corrected + rm.total_neg_time_corrected, corrected + DRIFT_S);
+
+    MOCK_advance_us(US_PER_S);
+    NEO6M_get_tick(&tick);
+    CHECK_EQ(tick.utc_time, rm.last_connected_utc + 1);
+    CHECK_EQ(last_lock_state, GPS_LOCKED); // sent again, the lock state is local to the task run
+}
+
+static void test_minute_sync(void)
+{
+    size_t cnt;
+    uint32_t pulses = 0;
+    int64_t first_start_us = 0;
+    int64_t prev_start_us = 0;
+    bool back_to_back = true;
+    task_msg_t tick;
+
+    rm.current_minutes_12o_clock = FACE_MINUTES;
+    MOCK_GPIO_reset();
+    shutdown_us = esp_timer_get_time() + 60 * US_PER_S; // a full minute is crossed, the sync takes < 1s
+    MOCK_run_task(TIMEKEEP_Task, NULL);
+
+    CHECK_EQ(shutdown_us, 0); // ended by the shutdown, not before
+    CHECK_EQ(rm.current_minutes_12o_clock, TARGET_MINUTES);
+    CHECK(local_time_cnt >= 59);
+    CHECK(!last_local_time.provisional);
+    CHECK_EQ(last_local_time.local_time.tm_hour, 1);
+
+    // a pulse is low for PULSE_LEN_MS then high, the activity toggles of the LED are a second apart
+    const mock_gpio_level_t* log = MOCK_GPIO_log(&cnt);
+    for (size_t idx = 1; idx < cnt; idx++)
+    {
+        if (log[idx].gpio != GPIO_LED || log[idx - 1].gpio != GPIO_LED)
+            continue;
+        if (log[idx - 1].level != 0 || log[idx].level != 1 || log[idx].us - log[idx - 1].us != PULSE_LEN_MS * 1000)
+            continue;
+
+        int64_t start_us = log[idx - 1].us;
+        if (pulses == 0)
+            first_start_us = start_us;
+        else if (start_us - prev_start_us != (PULSE_LEN_MS + PULSE_PAUSE_MS) * 1000)
+            back_to_back = false;
+        prev_start_us = start_us;
+        pulses++;
+    }
+    CHECK_EQ(pulses, TARGET_MINUTES - FACE_MINUTES);
+    CHECK(back_to_back);
+    NEO6M_get_tick(&tick);
+    CHECK_EQ((tick.tick_us - first_start_us) % US_PER_S, 0); // the train starts with the tick of the full minute
+    CHECK_EQ(log[cnt - 1].level, 0); // the LED is switched off on shutdown
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    MOCK_log_init();
+    MOCK_set_blocked_hook(other_tasks);
+    rm.pulse_len_ms = PULSE_LEN_MS;
+    rm.pulse_pause_ms = PULSE_PAUSE_MS;
+    rm.last_alt_cm = INT32_MAX;
+
+    RUN(test_first_fix);
+    RUN(test_drift_correction);
+    RUN(test_minute_sync);
+    return UNIT_RESULT();
+}
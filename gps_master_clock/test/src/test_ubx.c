@@ -0,0 +1,267 @@
+#include <string.h>
+
+#include "unit.h"
+#include "ubx.h"
+
+//---------------------------------------------------------------------------
+// Types
+//---------------------------------------------------------------------------
+
+typedef enum
+{
+    RX_SYNC_1,
+    RX_SYNC_2,
+    RX_HEADER,
+    RX_PAYLOAD,
+    RX_CK_A,
+    RX_CK_B,
+} rx_state_t;
+
+// UBX-AID-INI as the receiver interprets it, u-blox 6 receiver description 33.5
+typedef struct
+{
+    int32_t lat_e7;
+    int32_t lon_e7;
+    int32_t alt_cm;
+    uint32_t pos_acc_cm;
+    uint16_t wn;
+    uint32_t tow_ms;
+    uint32_t t_acc_ms;
+    uint32_t flags;
+} aid_ini_t;
+
+// UBX input parser of a fake receiver
+typedef struct
+{
+    rx_state_t state;
+    uint8_t header[4]; // class, id, length
+    uint8_t payload[256];
+    uint16_t len;
+    uint16_t pos;
+    uint8_t ck_a, ck_b;
+    uint32_t frames;
+    uint32_t bad_checksums;
+    aid_ini_t aid;
+} fake_receiver_t;
+
+//---------------------------------------------------------------------------
+// Local variables
+//---------------------------------------------------------------------------
+
+static fake_receiver_t rx;
+
+//---------------------------------------------------------------------------
+// Local functions
+//---------------------------------------------------------------------------
+
+static uint32_t get_u32_le(const uint8_t* src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+static void rx_checksum(fake_receiver_t* r, uint8_t c)
+{
+    r->ck_a += c;
+    r->ck_b += r->ck_a;
+}
+
+static void rx_frame_done(fake_receiver_t* r)
+{
+    r->frames++;
+    if (r->header[0] != UBX_CLASS_AID || r->header[1] != UBX_ID_AID_INI || r->len != UBX_AID_INI_LEN)
+        return;
+
+    const uint8_t* p = r->payload;
+    r->aid.lat_e7 = get_u32_le(&p[0]);
+    r->aid.lon_e7 = get_u32_le(&p[4]);
+    r->aid.alt_cm = get_u32_le(&p[8]);
+    r->aid.pos_acc_cm = get_u32_le(&p[12]);
+    r->aid.wn = p[18] | (p[19] << 8);
+    r->aid.tow_ms = get_u32_le(&p[20]);
+    r->aid.t_acc_ms = get_u32_le(&p[28]);
+    r->aid.flags = get_u32_le(&p[44]);
+}
+
+// one byte from the UART, everything which is not a valid UBX frame (e.g. NMEA) is skipped
+static void rx_byte(fake_receiver_t* r, uint8_t c)
+{
+    switch (r->state)
+    {
+    case RX_SYNC_1:
+        if (c == UBX_SYNC_1)
+            r->state = RX_SYNC_2;
+        break;
+    case RX_SYNC_2:
+        r->state = (c == UBX_SYNC_2) ? RX_HEADER : (c == UBX_SYNC_1) ? RX_SYNC_2 : RX_SYNC_1;
+        r->pos = 0;
+        r->ck_a = r->ck_b = 0;
+        break;
+    case RX_HEADER:
+        rx_checksum(r, c);
+        r->header[r->pos++] = c;
+        if (r->pos == sizeof(r->header))
+        {
+            r->len = r->header[2] | (r->header[3] << 8);
+            r->pos = 0;
+            r->state = (r->len > sizeof(r->payload)) ? RX_SYNC_1 : (r->len > 0) ? RX_PAYLOAD : RX_CK_A;
+        }
+        break;
+    case RX_PAYLOAD:
+        rx_checksum(r, c);
+        r->payload[r->pos++] = c;
+        if (r->pos == r->len)
+            r->state = RX_CK_A;
+        break;
+    case RX_CK_A:
+        r->state = (c == r->ck_a) ? RX_CK_B : RX_SYNC_1;
+        if (c != r->ck_a)
+            r->bad_checksums++;
+        break;
+    case RX_CK_B:
+        r->state = RX_SYNC_1;
+        if (c == r->ck_b)
+            rx_frame_done(r);
+        else
+            r->bad_checksums++;
+        break;
+    }
+}
+
+static void rx_bytes(fake_receiver_t* r, const uint8_t* data, size_t len)
+{
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        rx_byte(r, data[idx]);
+    }
+}
+
+// what send_aiding() writes to the UART
+static size_t aid_frame(uint8_t* frame, size_t frame_len, const ubx_aid_t* aid, uint32_t* flags)
+{
+    uint8_t payload[UBX_AID_INI_LEN];
+    *flags = UBX_aid_ini_payload(payload, aid);
+    return UBX_frame(frame, frame_len, UBX_CLASS_AID, UBX_ID_AID_INI, payload, sizeof(payload));
+}
+
+static void test_nothing_to_aid(void)
+{
+    uint8_t payload[UBX_AID_INI_LEN];
+    ubx_aid_t aid = { 0 };
+
+    memset(payload, 0xAA, sizeof(payload));
+    CHECK_EQ(UBX_aid_ini_payload(payload, &aid), 0);
+    for (uint8_t idx = 0; idx < sizeof(payload); idx++)
+    {
+        CHECK_EQ(payload[idx], 0);
+    }
+}
+
+static void test_position(void)
+{
+    uint8_t frame[UBX_AID_INI_LEN + UBX_FRAME_OVERHEAD];
+    uint32_t flags;
+    ubx_aid_t aid = { .pos_valid = true, .lat_e7 = 480000000 + 1234567, .lon_e7 = 116000000, .alt_valid = true,
+        .alt_cm = 52000 };
+
+    memset(&rx, 0, sizeof(rx));
+    CHECK_EQ(aid_frame(frame, sizeof(frame), &aid, &flags), sizeof(frame));
+    rx_bytes(&rx, frame, sizeof(frame));
+    CHECK_EQ(rx.frames, 1);
+    CHECK_EQ(rx.bad_checksums, 0);
+    CHECK_EQ(rx.aid.flags, flags);
+    CHECK_EQ(rx.aid.flags, UBX_AID_INI_FLAG_POS | UBX_AID_INI_FLAG_LLA);
+    CHECK_EQ(rx.aid.lat_e7, 481234567);
+    CHECK_EQ(rx.aid.lon_e7, 116000000);
+    CHECK_EQ(rx.aid.alt_cm, 52000);
+    CHECK_EQ(rx.aid.pos_acc_cm, UBX_AID_INI_POS_ACC_CM);
+    CHECK_EQ(rx.aid.wn, 0);
+    CHECK_EQ(rx.aid.tow_ms, 0);
+
+    // southern and western hemisphere, altitude unknown
+    aid = (ubx_aid_t){ .pos_valid = true, .lat_e7 = -338688000, .lon_e7 = -704000000 };
+    memset(&rx, 0, sizeof(rx));
+    aid_frame(frame, sizeof(frame), &aid, &flags);
+    rx_bytes(&rx, frame, sizeof(frame));
+    CHECK_EQ(rx.frames, 1);
+    CHECK_EQ(rx.aid.flags, UBX_AID_INI_FLAG_POS | UBX_AID_INI_FLAG_LLA | UBX_AID_INI_FLAG_ALTINV);
+    CHECK_EQ(rx.aid.lat_e7, -338688000);
+    CHECK_EQ(rx.aid.lon_e7, -704000000);
+    CHECK_EQ(rx.aid.alt_cm, 0);
+}
+
+static void test_time(void)
+{
+    uint8_t frame[UBX_AID_INI_LEN + UBX_FRAME_OVERHEAD];
+    uint32_t flags;
+
+    // 2024-01-01 00:00:00 UTC is monday of GPS week 2295, 18 leap seconds after midnight GPS time
+    ubx_aid_t aid = { .time_valid = true, .utc = 1704067200 };
+    memset(&rx, 0, sizeof(rx));
+    aid_frame(frame, sizeof(frame), &aid, &flags);
+    rx_bytes(&rx, frame, sizeof(frame));
+    CHECK_EQ(rx.frames, 1);
+    CHECK_EQ(rx.aid.flags, UBX_AID_INI_FLAG_TIME);
+    CHECK_EQ(rx.aid.wn, 2295);
+    CHECK_EQ(rx.aid.tow_ms, (24 * 3600 + 18) * 1000);
+    CHECK_EQ(rx.aid.t_acc_ms, UBX_AID_INI_TIME_ACC_MS);
+    CHECK_EQ(rx.aid.pos_acc_cm, 0);
+
+    // both, last second of a GPS week: 2024-01-06 23:59:41 UTC
+    aid = (ubx_aid_t){ .pos_valid = true, .lat_e7 = 1, .lon_e7 = 2, .time_valid = true, .utc = 1704585581 };
+    memset(&rx, 0, sizeof(rx));
+    aid_frame(frame, sizeof(frame), &aid, &flags);
+    rx_bytes(&rx, frame, sizeof(frame));
+    CHECK_EQ(rx.aid.flags,
+        UBX_AID_INI_FLAG_POS | UBX_AID_INI_FLAG_LLA | UBX_AID_INI_FLAG_ALTINV | UBX_AID_INI_FLAG_TIME);
+    CHECK_EQ(rx.aid.wn, 2295);
+    CHECK_EQ(rx.aid.tow_ms, (SECONDS_PER_WEEK - 1) * 1000);
+}
+
+static void test_framing(void)
+{
+    static const char nmea[] = "$GPGGA,,,,,,0,00,99.99,,,,,,*48\r\n\xB5$GPRMC";
+    uint8_t frame[UBX_AID_INI_LEN + UBX_FRAME_OVERHEAD];
+    uint32_t flags;
+    ubx_aid_t aid = { .time_valid = true, .utc = 1704067200 };
+
+    aid_frame(frame, sizeof(frame), &aid, &flags);
+    CHECK_EQ(frame[0], UBX_SYNC_1);
+    CHECK_EQ(frame[1], UBX_SYNC_2);
+    CHECK_EQ(frame[4], UBX_AID_INI_LEN);
+    CHECK_EQ(frame[5], 0);
+
+    // in the middle of other traffic, including a stray sync char
+    memset(&rx, 0, sizeof(rx));
+    rx_bytes(&rx, (const uint8_t*)nmea, sizeof(nmea) - 1);
+    rx_bytes(&rx, frame, sizeof(frame));
+    rx_bytes(&rx, (const uint8_t*)nmea, sizeof(nmea) - 1);
+    CHECK_EQ(rx.frames, 1);
+    CHECK_EQ(rx.bad_checksums, 0);
+    CHECK_EQ(rx.aid.wn, 2295);
+
+    // a single flipped bit is rejected by the receiver
+    for (size_t idx = 2; idx < sizeof(frame); idx++)
+    {
+        memset(&rx, 0, sizeof(rx));
+        frame[idx] ^= 0x10;
+        rx_bytes(&rx, frame, sizeof(frame));
+        frame[idx] ^= 0x10;
+        CHECK_EQ(rx.frames, 0);
+    }
+
+    // does not fit
+    CHECK_EQ(aid_frame(frame, sizeof(frame) - 1, &aid, &flags), 0);
+}
+
+//---------------------------------------------------------------------------
+// Global functions
+//---------------------------------------------------------------------------
+
+int main(void)
+{
+    RUN(test_nothing_to_aid);
+    RUN(test_position);
+    RUN(test_time);
+    RUN(test_framing);
+    return UNIT_RESULT();
+}
@@ -0,0 +1,6 @@
+#ifndef _STUB_GPTIMER_H_
+#define _STUB_GPTIMER_H_
+
+// Host replacement of the ESP-IDF header, nothing of it is used by the modules under test
+
+#endif // _STUB_GPTIMER_H_
@@ -0,0 +1,12 @@
+#ifndef _STUB_ESP_ATTR_H_
+#define _STUB_ESP_ATTR_H_
+
+// Host replacement of the ESP-IDF header: no special memory regions on the host
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_IRAM_ATTR
+
+#endif // _STUB_ESP_ATTR_H_
@@ -0,0 +1,12 @@
+#ifndef _STUB_ESP_CPU_H_
+#define _STUB_ESP_CPU_H_
+
+// Host replacement of the ESP-IDF header, the cycle counter follows the virtual time (see mock.h)
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#endif // _STUB_ESP_CPU_H_
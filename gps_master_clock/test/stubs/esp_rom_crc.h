@@ -0,0 +1,13 @@
+#ifndef _STUB_ESP_ROM_CRC_H_
+#define _STUB_ESP_ROM_CRC_H_
+
+// Host replacement of the ESP-IDF header, implemented in mock_nvs.c
+
+#include <stdint.h>
+
+// CRC32 (IEEE 802.3), same result as the ROM function and zlib's crc32()
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
+// CRC8 with polynomial 0x07, reflected like the ROM function
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t* buf, uint32_t len);
+
+#endif // _STUB_ESP_ROM_CRC_H_
@@ -0,0 +1,10 @@
+#ifndef _STUB_ESP_ROM_SYS_H_
+#define _STUB_ESP_ROM_SYS_H_
+
+// Host replacement of the ESP-IDF header
+
+#include <stdint.h>
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void);
+
+#endif // _STUB_ESP_ROM_SYS_H_
@@ -0,0 +1,10 @@
+#ifndef _STUB_ESP_RTC_TIME_H_
+#define _STUB_ESP_RTC_TIME_H_
+
+// Host replacement of the ESP-IDF header, the RTC timer is the virtual time plus an offset set by the test
+
+#include <stdint.h>
+
+uint64_t esp_rtc_get_time_us(void);
+
+#endif // _STUB_ESP_RTC_TIME_H_
@@ -0,0 +1,24 @@
+#ifndef _STUB_ESP_SYSTEM_H_
+#define _STUB_ESP_SYSTEM_H_
+
+// Host replacement of the ESP-IDF header, the reset reason is set by the test (see mock.h)
+
+#include "esp_err.h"
+
+typedef enum
+{
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+} esp_reset_reason_t;
+
+esp_reset_reason_t esp_reset_reason(void);
+
+#endif // _STUB_ESP_SYSTEM_H_
@@ -0,0 +1,35 @@
+#ifndef _STUB_ESP_TIMER_H_
+#define _STUB_ESP_TIMER_H_
+
+// Host replacement of the ESP-IDF header, the time is the virtual time of the mocks (see mock.h)
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct esp_timer* esp_timer_handle_t;
+
+typedef enum
+{
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    void (*callback)(void* arg);
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+int64_t esp_timer_get_time(void);
+
+// one timer at a time, its callback runs while MOCK_advance_us() passes the period
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+void esp_timer_isr_dispatch_need_yield(void);
+
+#endif // _STUB_ESP_TIMER_H_
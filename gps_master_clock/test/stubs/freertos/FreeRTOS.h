@@ -0,0 +1,77 @@
+#ifndef _STUB_FREERTOS_H_
+#define _STUB_FREERTOS_H_
+
+/* Host replacement of the FreeRTOS headers. The tests are single threaded: blocking calls run the other
+ * "task" through the blocked hook, or advance the virtual time until the timeout (see mock.h). */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h> // the ESP-IDF headers pull it in as well
+
+#include "esp_attr.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+
+#define portNUM_PROCESSORS      2
+#define PRO_CPU_NUM             0
+#define APP_CPU_NUM             1
+#define tskNO_AFFINITY          0x7FFFFFFF
+#define tskIDLE_PRIORITY        0
+
+// nothing runs concurrently
+typedef struct
+{
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux)    ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux)     ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)     ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)      ((void)(mux))
+#define portYIELD_FROM_ISR(...)         do { } while (0)
+
+// kernel objects of the mock
+struct mock_sem
+{
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+struct mock_queue
+{
+    uint8_t* storage;
+    UBaseType_t len;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t cnt;
+};
+
+typedef struct mock_sem StaticSemaphore_t;
+typedef struct mock_sem* SemaphoreHandle_t;
+typedef struct mock_queue StaticQueue_t;
+typedef struct mock_queue* QueueHandle_t;
+typedef void* TaskHandle_t;
+typedef struct
+{
+    int unused;
+} StaticTask_t;
+
+// after the types, semphr.h includes this header. Like idf_additions.h does on the target, custom_main.h relies on it
+#include "freertos/semphr.h"
+
+#endif // _STUB_FREERTOS_H_
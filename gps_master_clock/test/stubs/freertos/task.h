@@ -0,0 +1,26 @@
+#ifndef _STUB_TASK_H_
+#define _STUB_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef enum
+{
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+
+// a single notification value, only the task under test waits on it
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* woken);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t timeout);
+// suspending itself ends the task, MOCK_run_task() returns
+void vTaskSuspend(TaskHandle_t task);
+
+#endif // _STUB_TASK_H_
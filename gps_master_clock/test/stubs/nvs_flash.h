@@ -0,0 +1,11 @@
+#ifndef _STUB_NVS_FLASH_H_
+#define _STUB_NVS_FLASH_H_
+
+// Host replacement of the ESP-IDF header
+
+#include "esp_err.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif // _STUB_NVS_FLASH_H_
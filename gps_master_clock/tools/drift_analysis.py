@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Offline analysis of the drift dumps (DRIFT_dump) in a captured log.
+
+Picks the "utc,offset_us" CSV blocks out of the log, other log lines printed in between are skipped. For each
+block (or only the last one with --last) it prints the frequency offset as least squares fit and between the
+end points (as the firmware does), the residual phase noise, the holdover until the clock is 1 s off, and the
+overlapping Allan deviation for octave spaced tau. Triples spanning a gap (missing GPS seconds) are skipped.
+
+    python3 drift_analysis.py log.txt [--last] [--csv out.csv]
+"""
+
+import argparse
+import math
+import re
+import sys
+
+SAMPLE = re.compile(r"^(\d+),(-?\d+)\s*$")
+HEADER = "utc,offset_us"
+
+
+def read_blocks(lines):
+    blocks = []
+    current = None
+    for line in lines:
+        line = line.strip()
+        if line.endswith(HEADER):
+            current = []
+            blocks.append(current)
+            continue
+        m = SAMPLE.match(line)
+        if m and current is not None:
+            current.append((int(m.group(1)), int(m.group(2))))
+        elif line.startswith("Drift:"):
+            current = None  # the summary follows the last sample
+    return [b for b in blocks if len(b) >= 2]
+
+
+def fit_ppm(samples):
+    n = len(samples)
+    t0 = samples[0][0]
+    xs = [utc - t0 for utc, _ in samples]
+    ys = [off for _, off in samples]
+    mx = sum(xs) / n
+    my = sum(ys) / n
+    sxx = sum((x - mx) ** 2 for x in xs)
+    slope = sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / sxx if sxx else 0.0
+    residual = math.sqrt(sum((y - my - slope * (x - mx)) ** 2 for x, y in zip(xs, ys)) / n)
+    return slope, residual
+
+
+def adev(samples):
+    interval = min(b[0] - a[0] for a, b in zip(samples, samples[1:]))
+    result = []
+    m = 1
+    while 2 * m < len(samples):
+        tau = m * interval
+        total = 0.0
+        n = 0
+        for i in range(len(samples) - 2 * m):
+            a, b, c = samples[i], samples[i + m], samples[i + 2 * m]
+            if b[0] - a[0] != tau or c[0] - b[0] != tau:
+                continue
+            d = c[1] - 2 * b[1] + a[1]
+            total += d * d
+            n += 1
+        if n:
+            result.append((tau, math.sqrt(total / (2 * n)) / (tau * 1e6), n))
+        m *= 2
+    return interval, result
+
+
+def analyse(samples):
+    first, last = samples[0], samples[-1]
+    span = last[0] - first[0]
+    end_ppm = (last[1] - first[1]) / span
+    ppm, residual = fit_ppm(samples)
+    interval, adevs = adev(samples)
+
+    print(f"{len(samples)} samples over {span}s (interval {interval}s), utc {first[0]}..{last[0]}")
+    print(f"  drift: {ppm:.3f}ppm fit, {end_ppm:.3f}ppm end points, residual phase {residual:.0f}us rms")
+    holdover = 1e6 / abs(ppm) / 3600 if ppm else math.inf
+    print(f"  holdover until 1s off: {holdover:.1f}h")
+    for tau, dev, n in adevs:
+        print(f"  ADEV tau {tau:6d}s: {dev:.2e} (n={n})")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", nargs="?", help="captured log, stdin if omitted")
+    parser.add_argument("--last", action="store_true", help="only the last dump")
+    parser.add_argument("--csv", help="write the samples of the last dump to this file")
+    args = parser.parse_args()
+
+    with (open(args.log, errors="replace") if args.log else sys.stdin) as f:
+        blocks = read_blocks(f)
+    if not blocks:
+        sys.exit("no drift dump found")
+
+    for samples in (blocks[-1:] if args.last else blocks):
+        analyse(samples)
+
+    if args.csv:
+        with open(args.csv, "w") as f:
+            f.write(HEADER + "\n")
+            f.writelines(f"{utc},{off}\n" for utc, off in blocks[-1])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Turns a log captured with NMEA_CAPTURE (neo6m.h) into a corpus for the host replay test (test/nmea).
+
+The receiver output goes into <name>.nmea as it was received, the timestamps the firmware accepted
+("Accepted utc ..." between the lines) into <name>.expected. All other log lines are dropped. The capture
+has gaps if the periodic stats report dropped lines, such a log is refused.
+
+    python3 nmea_corpus.py log.txt ../test/nmea/<name> [--title "what the capture shows"]
+"""
+
+import argparse
+import re
+import sys
+
+LOG_LINE = re.compile(r"^\d{8} \w+\(\): (.*)$")
+ACCEPTED = re.compile(r"^Accepted utc (-?\d+) age \d+$")
+DROPPED = re.compile(r"^NMEA capture: (\d+) lines dropped$")
+
+
+def split_log(lines):
+    nmea, accepted, dropped = [], [], 0
+    for line in lines:
+        m = LOG_LINE.match(line.rstrip("\r\n"))
+        if not m:
+            nmea.append(line)
+            continue
+        a = ACCEPTED.match(m.group(1))
+        d = DROPPED.match(m.group(1))
+        if a:
+            accepted.append(int(a.group(1)))
+        elif d:
+            dropped += int(d.group(1))
+    return nmea, accepted, dropped
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="captured log")
+    parser.add_argument("corpus", help="output path without extension")
+    parser.add_argument("--title", default="Captured with NMEA_CAPTURE", help="comment at the top of the corpus")
+    args = parser.parse_args()
+
+    with open(args.log, newline="", encoding="latin-1") as f:
+        nmea, accepted, dropped = split_log(f)
+    if dropped:
+        sys.exit(f"{dropped} lines were dropped during the capture, the replay would not match")
+    if not accepted:
+        sys.exit("no accepted timestamp in the log, was NMEA_CAPTURE enabled?")
+
+    with open(args.corpus + ".nmea", "w", newline="", encoding="latin-1") as f:
+        f.write(f"# {args.title}\n")
+        f.writelines(nmea)
+    with open(args.corpus + ".expected", "w") as f:
+        f.write(f"# utc of every accepted timestamp of {args.corpus.split('/')[-1]}.nmea, in order\n")
+        f.writelines(f"{utc}\n" for utc in accepted)
+    print(f"{len(nmea)} lines, {len(accepted)} timestamps")
+
+
+if __name__ == "__main__":
+    main()